@@ -0,0 +1,479 @@
+/*
+ * Copyright (C) 2009-2012 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <math.h>
+#include <string.h>
+#include <grits.h>
+
+#include "anim.h"
+
+typedef enum {
+	FRAME_EMPTY,
+	FRAME_LOADING,
+	FRAME_READY,   // Image is waiting to be uploaded
+	FRAME_SHOWN,   // Image is in a texture
+	FRAME_FAILED,
+} AnimFrameState;
+
+struct _AnimFrame {
+	gchar          *name;
+	AnimFrameState  state;
+	AWeatherSweep  *sweep;  // Lowest tilt, gates are only kept for tweening
+	guint8         *pixels; // Colored b-scan, freed once uploaded
+	gint            width;
+	gint            height;
+	gsize           size;   // Bytes counted against the budget
+	guint           tex;
+	gdouble         coords[2];
+	AnimFrame     **tweens; // Frames between this one and the next
+	gint            ntweens;
+	gchar          *next;   // Name of the frame the tweens lead to
+	gboolean        tweening;
+};
+
+/**********
+ * Frames *
+ **********/
+/* Copy the ray geometry of a sweep, the gates are kept in the image unless
+ * they are needed to draw tweens */
+static AWeatherSweep *_frame_sweep(AWeatherSweep *src, gboolean gates)
+{
+	AWeatherSweep *sweep = g_new0(AWeatherSweep, 1);
+	*sweep = *src;
+	sweep->azimuth = g_new(gfloat, src->nrays);
+	sweep->elevs   = g_new(gfloat, src->nrays);
+	memcpy(sweep->azimuth, src->azimuth, src->nrays*sizeof(gfloat));
+	memcpy(sweep->elevs,   src->elevs,   src->nrays*sizeof(gfloat));
+	sweep->codes   = NULL;
+	sweep->index   = NULL;
+	sweep->mapped  = FALSE;
+	if (gates) {
+		gsize size = (gsize)src->nrays*src->nbins*src->depth;
+		sweep->codes = g_memdup(src->codes, size);
+		aweather_sweep_index(sweep);
+	}
+	return sweep;
+}
+
+static gsize _sweep_size(AWeatherSweep *sweep)
+{
+	return sweep && sweep->codes ?
+		(gsize)sweep->nrays*sweep->nbins*sweep->depth : 0;
+}
+
+/* Frames with textures are only freed from the main thread */
+static void _frame_free(AnimFrame *frame)
+{
+	for (gint i = 0; i < frame->ntweens; i++)
+		_frame_free(frame->tweens[i]);
+	if (frame->sweep)
+		aweather_sweep_free(frame->sweep);
+	if (frame->tex)
+		glDeleteTextures(1, &frame->tex);
+	g_free(frame->tweens);
+	g_free(frame->pixels);
+	g_free(frame->next);
+	g_free(frame->name);
+	g_free(frame);
+}
+
+/* Drop the frames between a frame and the next one */
+static void _frame_untween(AWeatherAnim *anim, AnimFrame *frame)
+{
+	for (gint i = 0; i < frame->ntweens; i++) {
+		if (anim->shown == frame->tweens[i])
+			anim->shown = frame;
+		anim->used -= frame->tweens[i]->size;
+		_frame_free(frame->tweens[i]);
+	}
+	g_free(frame->tweens);
+	g_free(frame->next);
+	frame->tweens  = NULL;
+	frame->ntweens = 0;
+	frame->next    = NULL;
+}
+
+static gint _anim_find(AWeatherAnim *anim, const gchar *name)
+{
+	for (gint fi = 0; fi < anim->nframes; fi++)
+		if (anim->frames[fi] && g_str_equal(anim->frames[fi]->name, name))
+			return fi;
+	return -1;
+}
+
+
+/**********
+ * Worker *
+ **********/
+/* Frames are loaded in the order they will be shown, starting from the
+ * current frame. Nothing new is loaded once the budget is used up. */
+static AnimFrame *_anim_next(AWeatherAnim *anim, gsize estimate)
+{
+	if (anim->used + estimate > anim->budget)
+		return NULL;
+	for (gint i = 0; i < anim->nframes; i++) {
+		gint fi = (MAX(anim->current, 0) + i) % anim->nframes;
+		if (anim->frames[fi]->state == FRAME_EMPTY)
+			return anim->frames[fi];
+	}
+	return NULL;
+}
+
+/* Tweens are drawn once the frames on either side are loaded, in the same
+ * order. Returns the index of the first frame of the pair, or -1. */
+static gint _anim_next_tween(AWeatherAnim *anim, gsize estimate)
+{
+	if (anim->tween == TWEEN_NONE || anim->steps <= 0)
+		return -1;
+	if (anim->used + estimate*anim->steps > anim->budget)
+		return -1;
+	for (gint i = 0; i < anim->nframes-1; i++) {
+		gint fi = (MAX(anim->current, 0) + i) % anim->nframes;
+		if (fi+1 >= anim->nframes)
+			continue;
+		AnimFrame *a = anim->frames[fi], *b = anim->frames[fi+1];
+		if (a->tweens || a->tweening)
+			continue;
+		if (_sweep_size(a->sweep) && _sweep_size(b->sweep))
+			return fi;
+	}
+	return -1;
+}
+
+/* Draw the frames between a pair of loaded frames, called without the
+ * lock held on copies of both sweeps */
+static AnimFrame **_anim_tween(AWeatherAnim *anim, AWeatherSweep *a,
+		AWeatherSweep *b, AWeatherTweenMode mode, gint steps)
+{
+	AWeatherTweenField *field  = mode == TWEEN_MOTION ?
+		aweather_tween_field(a, b) : NULL;
+	AnimFrame         **tweens = g_new0(AnimFrame*, steps);
+	for (gint i = 0; i < steps; i++) {
+		AnimFrame *tween = g_new0(AnimFrame, 1);
+		tween->sweep  = aweather_tween_sweep(a);
+		tween->width  = tween->sweep->nbins;
+		tween->height = tween->sweep->nrays;
+		tween->size   = (gsize)tween->width*tween->height*4;
+		tween->pixels = g_malloc(tween->size);
+		tween->state  = FRAME_READY;
+		aweather_tween_frame(a, b, field, anim->colormap,
+				(i+1.0)/(steps+1), tween->sweep, tween->pixels);
+		tweens[i] = tween;
+	}
+	g_free(field);
+	return tweens;
+}
+
+/* Attach tweens unless either frame changed while they were drawn */
+static gboolean _anim_attach(AWeatherAnim *anim, const gchar *first,
+		const gchar *next, AnimFrame **tweens, gint steps)
+{
+	gint fi = _anim_find(anim, first);
+	if (fi < 0)
+		return FALSE;
+	AnimFrame *frame = anim->frames[fi];
+	frame->tweening = FALSE;
+	if (fi+1 >= anim->nframes || frame->tweens ||
+	    !g_str_equal(anim->frames[fi+1]->name, next))
+		return FALSE;
+	g_debug("AWeatherAnim: attach - %s -> %s", first, next);
+	frame->tweens  = tweens;
+	frame->ntweens = steps;
+	frame->next    = g_strdup(next);
+	for (gint i = 0; i < steps; i++)
+		anim->used += tweens[i]->size;
+	return TRUE;
+}
+
+static gpointer _anim_thread(gpointer _anim)
+{
+	AWeatherAnim *anim     = _anim;
+	gsize         estimate = 0; // Size of the last frame
+	g_mutex_lock(&anim->lock);
+	while (TRUE) {
+		AnimFrame *frame = NULL;
+		gint       pair  = -1;
+		while (anim->running && !(frame = _anim_next(anim, estimate)) &&
+				(pair = _anim_next_tween(anim, estimate/4)) < 0)
+			g_cond_wait(&anim->cond, &anim->lock);
+		if (!anim->running)
+			break;
+
+		/* Fill in between two loaded frames */
+		if (!frame) {
+			AnimFrame        *fa    = anim->frames[pair];
+			AnimFrame        *fb    = anim->frames[pair+1];
+			gchar            *first = g_strdup(fa->name);
+			gchar            *next  = g_strdup(fb->name);
+			AWeatherSweep    *a     = _frame_sweep(fa->sweep, TRUE);
+			AWeatherSweep    *b     = _frame_sweep(fb->sweep, TRUE);
+			AWeatherTweenMode mode  = anim->tween;
+			gint              steps = anim->steps;
+			fa->tweening = TRUE;
+			g_mutex_unlock(&anim->lock);
+
+			AnimFrame **tweens = _anim_tween(anim, a, b, mode, steps);
+			aweather_sweep_free(a);
+			aweather_sweep_free(b);
+
+			g_mutex_lock(&anim->lock);
+			if (!_anim_attach(anim, first, next, tweens, steps)) {
+				for (gint i = 0; i < steps; i++)
+					_frame_free(tweens[i]);
+				g_free(tweens);
+			}
+			g_free(first);
+			g_free(next);
+			continue;
+		}
+
+		gchar *name = g_strdup(frame->name);
+		frame->state = FRAME_LOADING;
+		g_mutex_unlock(&anim->lock);
+
+		/* Load and color the lowest reflectivity tilt */
+		AWeatherSweep  *sweep  = NULL;
+		guint8         *pixels = NULL;
+		gint            width  = 0, height = 0;
+		gboolean        gates  = anim->tween != TWEEN_NONE;
+		AWeatherStore  *store  = anim->load(name, anim->load_data);
+		AWeatherVolume *volume = store ? aweather_store_volume(store, DZ_INDEX) : NULL;
+		AWeatherSweep  *lowest = volume ? aweather_volume_closest(volume, 0) : NULL;
+		if (lowest) {
+			aweather_level2_bscan(lowest, anim->colormap, NULL,
+					&pixels, &width, &height);
+			sweep = _frame_sweep(lowest, gates);
+		}
+		if (store)
+			aweather_store_free(store);
+
+		/* The frame may have been dropped while it was loading */
+		g_mutex_lock(&anim->lock);
+		gint fi = _anim_find(anim, name);
+		frame = fi >= 0 ? anim->frames[fi] : NULL;
+		if (frame && frame->state == FRAME_LOADING) {
+			g_debug("AWeatherAnim: thread - loaded %s", name);
+			frame->state  = sweep ? FRAME_READY : FRAME_FAILED;
+			frame->sweep  = sweep;
+			frame->pixels = pixels;
+			frame->width  = width;
+			frame->height = height;
+			frame->size   = (gsize)width*height*4 + _sweep_size(sweep);
+			anim->used   += frame->size;
+			estimate      = MAX(estimate, (gsize)width*height*4);
+		} else {
+			if (sweep)
+				aweather_sweep_free(sweep);
+			g_free(pixels);
+		}
+		g_free(name);
+	}
+	g_mutex_unlock(&anim->lock);
+	return NULL;
+}
+
+
+/***********
+ * Methods *
+ ***********/
+static gboolean _anim_tick(gpointer _anim)
+{
+	AWeatherAnim *anim  = _anim;
+	g_mutex_lock(&anim->lock);
+	gint          steps = anim->tween != TWEEN_NONE ? anim->steps : 0;
+
+	/* Step between frames, keeping the last image if a tween is missing */
+	if (anim->current >= 0 && anim->step < steps) {
+		AnimFrame *frame = anim->frames[anim->current];
+		AnimFrame *tween = anim->step < frame->ntweens ?
+			frame->tweens[anim->step] : NULL;
+		anim->step++;
+		if (tween)
+			anim->shown = tween;
+	}
+
+	/* Frames that aren't ready yet are skipped rather than waited for */
+	else for (gint i = 1; i <= anim->nframes; i++) {
+		gint fi = (anim->current + i) % anim->nframes;
+		AnimFrameState state = anim->frames[fi]->state;
+		if (state == FRAME_READY || state == FRAME_SHOWN) {
+			anim->current = fi;
+			anim->step    = 0;
+			anim->shown   = anim->frames[fi];
+			break;
+		}
+	}
+	g_cond_signal(&anim->cond);
+	g_mutex_unlock(&anim->lock);
+	grits_object_queue_draw(GRITS_OBJECT(anim));
+	return TRUE;
+}
+
+AWeatherAnim *aweather_anim_new(AWeatherAnimLoad load, gpointer data,
+		AWeatherColormap *colormap, gint max_frames, gsize budget)
+{
+	g_debug("AWeatherAnim: new - %d frames, %d MB",
+			max_frames, (gint)(budget>>20));
+	AWeatherAnim *anim = g_object_new(AWEATHER_TYPE_ANIM, NULL);
+	anim->load       = load;
+	anim->load_data  = data;
+	anim->colormap   = colormap;
+	anim->max_frames = CLAMP(max_frames, 1, ANIM_MAX_FRAMES);
+	anim->budget     = budget;
+	anim->thread     = g_thread_new("anim-thread", _anim_thread, anim);
+	return anim;
+}
+
+/* Set the volumes to loop through, oldest first. Frames that are already
+ * loaded are kept and the oldest names past the frame limit are dropped. */
+void aweather_anim_set_names(AWeatherAnim *anim, GList *names)
+{
+	g_debug("AWeatherAnim: set_names - %d", g_list_length(names));
+	AnimFrame *frames[ANIM_MAX_FRAMES] = {};
+	gint       nframes = 0;
+	gint       skip    = MAX(0, (gint)g_list_length(names) - anim->max_frames);
+
+	g_mutex_lock(&anim->lock);
+	for (GList *cur = g_list_nth(names, skip); cur; cur = cur->next) {
+		gint fi = _anim_find(anim, cur->data);
+		AnimFrame *frame = fi >= 0 ? anim->frames[fi] : NULL;
+		if (frame) {
+			anim->frames[fi] = NULL;
+		} else {
+			frame = g_new0(AnimFrame, 1);
+			frame->name = g_strdup(cur->data);
+		}
+		frames[nframes++] = frame;
+	}
+	for (gint fi = 0; fi < anim->nframes; fi++) {
+		if (anim->frames[fi] == NULL)
+			continue;
+		_frame_untween(anim, anim->frames[fi]);
+		anim->used -= anim->frames[fi]->size;
+		_frame_free(anim->frames[fi]);
+	}
+
+	/* Tweens only stay valid while the next frame is the same */
+	for (gint fi = 0; fi < nframes; fi++)
+		if (frames[fi]->tweens && (fi+1 >= nframes ||
+		    !g_str_equal(frames[fi]->next, frames[fi+1]->name)))
+			_frame_untween(anim, frames[fi]);
+	memcpy(anim->frames, frames, sizeof(frames));
+	anim->nframes = nframes;
+	anim->current = MIN(anim->current, nframes-1);
+	anim->step    = 0;
+	anim->shown   = anim->current >= 0 ? anim->frames[anim->current] : NULL;
+	g_cond_signal(&anim->cond);
+	g_mutex_unlock(&anim->lock);
+}
+
+/* Draw steps frames between each pair of volumes, this should be set
+ * before the names so existing frames keep their gates */
+void aweather_anim_set_tween(AWeatherAnim *anim, AWeatherTweenMode mode, gint steps)
+{
+	g_debug("AWeatherAnim: set_tween - %d %d", mode, steps);
+	g_mutex_lock(&anim->lock);
+	anim->tween = mode;
+	anim->steps = mode == TWEEN_NONE ? 0 : CLAMP(steps, 0, 30);
+	g_cond_signal(&anim->cond);
+	g_mutex_unlock(&anim->lock);
+}
+
+/* Loop through the volumes at a fixed rate, tweens are shown in between */
+void aweather_anim_play(AWeatherAnim *anim, gdouble fps)
+{
+	g_debug("AWeatherAnim: play - %f", fps);
+	aweather_anim_stop(anim);
+	gdouble rate = CLAMP(fps, 0.1, 60) * (anim->steps+1);
+	anim->timer = g_timeout_add(1000/MIN(rate, 60), _anim_tick, anim);
+}
+
+void aweather_anim_stop(AWeatherAnim *anim)
+{
+	if (anim->timer)
+		g_source_remove(anim->timer);
+	anim->timer = 0;
+}
+
+
+/*************
+ * Callbacks *
+ *************/
+static void aweather_anim_draw(GritsObject *_anim, GritsOpenGL *opengl)
+{
+	AWeatherAnim *anim = AWEATHER_ANIM(_anim);
+
+	/* Upload the current frame the first time it's shown */
+	g_mutex_lock(&anim->lock);
+	AnimFrame *frame = anim->shown;
+	if (frame && frame->state == FRAME_READY) {
+		aweather_level2_load_tex(&frame->tex, frame->coords,
+				frame->pixels, frame->width, frame->height);
+		g_free(frame->pixels);
+		frame->pixels = NULL;
+		frame->state  = FRAME_SHOWN;
+	}
+	g_mutex_unlock(&anim->lock);
+
+	if (frame && frame->state == FRAME_SHOWN)
+		aweather_level2_draw_sweep(frame->sweep, frame->tex, frame->coords);
+}
+
+
+/****************
+ * GObject code *
+ ****************/
+G_DEFINE_TYPE(AWeatherAnim, aweather_anim, GRITS_TYPE_OBJECT);
+static void aweather_anim_init(AWeatherAnim *anim)
+{
+	g_mutex_init(&anim->lock);
+	g_cond_init(&anim->cond);
+	anim->running = TRUE;
+	anim->current = -1;
+}
+static void aweather_anim_dispose(GObject *_anim)
+{
+	AWeatherAnim *anim = AWEATHER_ANIM(_anim);
+	g_debug("AWeatherAnim: dispose - %p", _anim);
+	aweather_anim_stop(anim);
+	if (anim->thread) {
+		g_mutex_lock(&anim->lock);
+		anim->running = FALSE;
+		g_cond_signal(&anim->cond);
+		g_mutex_unlock(&anim->lock);
+		g_thread_join(anim->thread);
+		anim->thread = NULL;
+	}
+	G_OBJECT_CLASS(aweather_anim_parent_class)->dispose(_anim);
+}
+static void aweather_anim_finalize(GObject *_anim)
+{
+	AWeatherAnim *anim = AWEATHER_ANIM(_anim);
+	g_debug("AWeatherAnim: finalize - %p", _anim);
+	for (gint fi = 0; fi < anim->nframes; fi++)
+		_frame_free(anim->frames[fi]);
+	g_mutex_clear(&anim->lock);
+	g_cond_clear(&anim->cond);
+	G_OBJECT_CLASS(aweather_anim_parent_class)->finalize(_anim);
+}
+static void aweather_anim_class_init(AWeatherAnimClass *klass)
+{
+	G_OBJECT_CLASS(klass)->dispose  = aweather_anim_dispose;
+	G_OBJECT_CLASS(klass)->finalize = aweather_anim_finalize;
+	GRITS_OBJECT_CLASS(klass)->draw = aweather_anim_draw;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2009-2012 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __AWEATHER_ANIM_H__
+#define __AWEATHER_ANIM_H__
+
+#include <grits.h>
+#include "level2.h"
+#include "tween.h"
+
+#define ANIM_MAX_FRAMES 64
+
+/* Anim */
+#define AWEATHER_TYPE_ANIM            (aweather_anim_get_type())
+#define AWEATHER_ANIM(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj),   AWEATHER_TYPE_ANIM, AWeatherAnim))
+#define AWEATHER_IS_ANIM(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj),   AWEATHER_TYPE_ANIM))
+#define AWEATHER_ANIM_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST   ((klass), AWEATHER_TYPE_ANIM, AWeatherAnimClass))
+#define AWEATHER_IS_ANIM_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE   ((klass), AWEATHER_TYPE_ANIM))
+#define AWEATHER_ANIM_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),   AWEATHER_TYPE_ANIM, AWeatherAnimClass))
+
+typedef struct _AWeatherAnim      AWeatherAnim;
+typedef struct _AWeatherAnimClass AWeatherAnimClass;
+
+/* Fetch and load the volume for a frame, called from the worker thread */
+typedef AWeatherStore *(*AWeatherAnimLoad)(const gchar *name, gpointer data);
+
+typedef struct _AnimFrame AnimFrame;
+
+struct _AWeatherAnim {
+	GritsObject       parent;
+	AWeatherAnimLoad  load;
+	gpointer          load_data;
+	AWeatherColormap *colormap;
+
+	/* Private */
+	GMutex            lock;
+	GCond             cond;
+	GThread          *thread;
+	gboolean          running;
+	AnimFrame        *frames[ANIM_MAX_FRAMES]; // Oldest first
+	gint              nframes;
+	gint              max_frames;
+	gsize             budget;   // Bytes of frames to keep
+	gsize             used;
+	gint              current;  // Frame being shown, or -1
+	guint             timer;
+	AWeatherTweenMode tween;    // Frames drawn between loaded volumes
+	gint              steps;    // Number of frames between each volume
+	gint              step;     // Frame after current being shown, or 0
+	AnimFrame        *shown;
+};
+
+struct _AWeatherAnimClass {
+	GritsObjectClass parent_class;
+};
+
+GType aweather_anim_get_type(void);
+
+AWeatherAnim *aweather_anim_new(AWeatherAnimLoad load, gpointer data,
+		AWeatherColormap *colormap, gint max_frames, gsize budget);
+
+void aweather_anim_set_names(AWeatherAnim *anim, GList *names);
+
+void aweather_anim_set_tween(AWeatherAnim *anim, AWeatherTweenMode mode, gint steps);
+
+void aweather_anim_play(AWeatherAnim *anim, gdouble fps);
+
+void aweather_anim_stop(AWeatherAnim *anim);
+
+#endif
@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2009-2012 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <math.h>
+#include <grits.h>
+#include <rsl.h>
+
+#include "cappi.h"
+
+#define CAPPI_MAXTILTS 32
+#define CAPPI_NONE     0xff
+#define CAPPI_TABLES   16 // Weight tables kept, the least recently used go first
+
+/* Which tilts to sample for each output gate, this only depends on
+ * the distance from the radar so one entry is kept for each bin */
+typedef struct {
+	guint8 tilt[2];  // Tilts below and above the height, or CAPPI_NONE
+	gfloat range[2]; // Slant range to the height along each tilt, m
+	gfloat weight;   // Weight given to the upper tilt
+} CappiBin;
+
+typedef struct {
+	CappiBin bin[CAPPI_BINS];
+} CappiTable;
+
+/* Rays to fill in */
+typedef struct {
+	CappiTable     *table;
+	AWeatherSweep **tilts;
+	gint           *gate;  // Source gate for each output bin and tilt, or -1
+	AWeatherSweep  *out;
+	gint            ri0, ri1;
+} CappiJob;
+
+/* Weight tables are shared by volumes with the same elevation angles, the
+ * measured angles change a little between volumes so only a few are kept */
+static GHashTable *cappi_tables;
+static GQueue      cappi_order; // Keys, most recently used first
+static GMutex      cappi_lock;
+
+static CappiTable *_cappi_table_new(gfloat *elevs, gint ntilts, gfloat height)
+{
+	CappiTable *table = g_new0(CappiTable, 1);
+	for (gint bi = 0; bi < CAPPI_BINS; bi++) {
+		CappiBin *bin  = &table->bin[bi];
+		gdouble   dist = (bi + 0.5) * CAPPI_GATE;
+		gdouble   h[CAPPI_MAXTILTS], r[CAPPI_MAXTILTS];
+		for (gint k = 0; k < ntilts; k++)
+			beam_height(dist, elevs[k], &h[k], &r[k]);
+
+		/* Allow half of the 1 degree beam width above and below
+		 * the highest and lowest tilts */
+		gdouble spread = dist * tan(deg2rad(0.5));
+		gint    lo = -1, hi = -1;
+		gdouble weight = 0;
+		if (height < h[0]) {
+			if (height > h[0] - spread)
+				lo = hi = 0;
+		} else if (height >= h[ntilts-1]) {
+			if (height < h[ntilts-1] + spread)
+				lo = hi = ntilts-1;
+		} else {
+			for (lo = 0; height >= h[lo+1]; lo++);
+			hi     = lo+1;
+			weight = (height - h[lo]) / (h[hi] - h[lo]);
+		}
+
+		bin->tilt[0]  = lo < 0 ? CAPPI_NONE : lo;
+		bin->tilt[1]  = hi < 0 ? CAPPI_NONE : hi;
+		bin->range[0] = lo < 0 ? 0 : r[lo];
+		bin->range[1] = hi < 0 ? 0 : r[hi];
+		bin->weight   = weight;
+	}
+	return table;
+}
+
+/* Find the cached weight table for the elevation angles and height, a copy
+ * is returned since it may be dropped from the cache while it's being used */
+static CappiTable *_cappi_table(gfloat *elevs, gint ntilts, gfloat height)
+{
+	GString *key = g_string_new("");
+	for (gint k = 0; k < ntilts; k++)
+		g_string_append_printf(key, "%.2f,", elevs[k]);
+	g_string_append_printf(key, "@%.0f", height);
+
+	g_mutex_lock(&cappi_lock);
+	if (!cappi_tables)
+		cappi_tables = g_hash_table_new_full(g_str_hash, g_str_equal,
+				g_free, g_free);
+	gpointer    name;
+	CappiTable *table;
+	if (g_hash_table_lookup_extended(cappi_tables, key->str, &name, (gpointer*)&table)) {
+		g_queue_remove(&cappi_order, name);
+	} else {
+		g_debug("AWeatherCappi: table - new %s", key->str);
+		name  = g_strdup(key->str);
+		table = _cappi_table_new(elevs, ntilts, height);
+		g_hash_table_insert(cappi_tables, name, table);
+		if (g_queue_get_length(&cappi_order) >= CAPPI_TABLES)
+			g_hash_table_remove(cappi_tables, g_queue_pop_tail(&cappi_order));
+	}
+	g_queue_push_head(&cappi_order, name);
+	table = g_memdup(table, sizeof(CappiTable));
+	g_mutex_unlock(&cappi_lock);
+
+	g_string_free(key, TRUE);
+	return table;
+}
+
+/* Gather and blend the two tilts for each output gate */
+static gpointer _cappi_apply(gpointer _job)
+{
+	CappiJob *job = _job;
+	AWeatherSweep *out = job->out;
+	for (gint ri = job->ri0; ri < job->ri1; ri++) {
+		gfloat az = out->azimuth[ri];
+		for (gint bi = 0; bi < CAPPI_BINS; bi++) {
+			CappiBin *bin = &job->table->bin[bi];
+			guint code[2] = {0, 0};
+			if (bin->tilt[0] == CAPPI_NONE)
+				continue;
+			for (gint j = 0; j < 2; j++) {
+				AWeatherSweep *src = job->tilts[bin->tilt[j]];
+				gint si = radar_azindex_get(src->index, az);
+				gint gi = job->gate[bi*2 + j];
+				if (si >= 0 && gi >= 0 && gi < src->nbins)
+					code[j] = aweather_sweep_code(src, si, gi);
+			}
+			gfloat w = bin->weight;
+			if (code[0] >= CODE_MIN && code[1] >= CODE_MIN)
+				aweather_sweep_set(out, ri, bi,
+						code[0]*(1-w) + code[1]*w + 0.5);
+			else
+				aweather_sweep_set(out, ri, bi, w < 0.5 ? code[0] : code[1]);
+		}
+	}
+	return NULL;
+}
+
+/* Resample a volume at a constant height above the radar, this takes a
+ * while so it shouldn't be called from the main thread */
+AWeatherSweep *aweather_cappi_sweep(AWeatherVolume *volume, gfloat height)
+{
+	g_debug("AWeatherCappi: sweep - %.0f", height);
+
+	/* Find tilts, skipping repeated elevations */
+	AWeatherSweep *tilts[CAPPI_MAXTILTS];
+	gfloat         elevs[CAPPI_MAXTILTS];
+	gint           ntilts = 0, depth = 1;
+	for (gint si = 0; si < volume->nsweeps && ntilts < CAPPI_MAXTILTS; si++) {
+		AWeatherSweep *sweep = volume->sweep[si];
+		if (sweep->elev == 0)
+			continue;
+		if (ntilts > 0 && sweep->elev == elevs[ntilts-1])
+			continue;
+		tilts[ntilts] = sweep;
+		elevs[ntilts] = sweep->elev;
+		depth = MAX(depth, sweep->depth);
+		ntilts++;
+	}
+	if (ntilts == 0)
+		return NULL;
+
+	/* Per volume lookups, these are small compared to the output */
+	CappiTable *table = _cappi_table(elevs, ntilts, height);
+	gint       *gate  = g_new(gint, CAPPI_BINS*2);
+	for (gint bi = 0; bi < CAPPI_BINS; bi++) {
+		for (gint j = 0; j < 2; j++) {
+			CappiBin *bin = &table->bin[bi];
+			if (bin->tilt[j] == CAPPI_NONE) {
+				gate[bi*2+j] = -1;
+				continue;
+			}
+			AWeatherSweep *tilt = tilts[bin->tilt[j]];
+			gate[bi*2+j] = floor((bin->range[j] - tilt->range_bin1) /
+					tilt->gate_size + 0.5);
+		}
+	}
+
+	/* Allocate output, blending is done on the codes so the tilts
+	 * are assumed to share the same gain and offset */
+	AWeatherSweep *out = aweather_sweep_new(CAPPI_INDEX,
+			CAPPI_RAYS, CAPPI_BINS, depth);
+	out->beam_width = 360.0/CAPPI_RAYS;
+	out->range_bin1 = CAPPI_GATE/2;
+	out->gate_size  = CAPPI_GATE;
+	out->gain       = tilts[0]->gain;
+	out->offset     = tilts[0]->offset;
+	for (gint ri = 0; ri < CAPPI_RAYS; ri++)
+		out->azimuth[ri] = (ri + 0.5) * 360.0/CAPPI_RAYS;
+	aweather_sweep_index(out);
+
+	/* Callers are already on a worker thread, so the rays aren't split up */
+	CappiJob job = {table, tilts, gate, out, 0, CAPPI_RAYS};
+	_cappi_apply(&job);
+
+	g_free(table);
+	g_free(gate);
+	return out;
+}
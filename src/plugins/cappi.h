@@ -0,0 +1,31 @@
+/*
+ * Copyright (C) 2009-2012 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __AWEATHER_CAPPI_H__
+#define __AWEATHER_CAPPI_H__
+
+#include <glib.h>
+#include "store.h"
+
+/* Polar grid the CAPPI is resampled on */
+#define CAPPI_RAYS 720     // Half degree rays
+#define CAPPI_BINS 920     // Out to 230 km
+#define CAPPI_GATE 250.0   // Quarter kilometer gates
+
+AWeatherSweep *aweather_cappi_sweep(AWeatherVolume *volume, gfloat height);
+
+#endif
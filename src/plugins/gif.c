@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2009-2012 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+
+#include "gif.h"
+
+#define LZW_MAX 4096 // Codes are at most 12 bits
+
+/* Read a color table, returns the position after it or 0 */
+static gsize _gif_palette(AWeatherGif *gif, const guint8 *data, gsize len,
+		gsize pos, gint flags)
+{
+	gint ncolors = 2 << (flags & 0x07);
+	if (pos + ncolors*3 > len)
+		return 0;
+	memcpy(gif->palette, data+pos, ncolors*3);
+	gif->ncolors = ncolors;
+	return pos + ncolors*3;
+}
+
+/* Join the data sub-blocks starting at pos, pos is moved past them */
+static guint8 *_gif_blocks(const guint8 *data, gsize len, gsize *pos, gsize *size)
+{
+	GByteArray *out = g_byte_array_new();
+	while (*pos < len && data[*pos] != 0) {
+		gsize block = data[*pos];
+		if (*pos + 1 + block > len)
+			break;
+		g_byte_array_append(out, data + *pos + 1, block);
+		*pos += 1 + block;
+	}
+	*pos += 1;
+	*size = out->len;
+	return g_byte_array_free(out, FALSE);
+}
+
+/* Decode LZW data into indices, returns the number of pixels decoded */
+static gsize _gif_lzw(const guint8 *in, gsize len, gint min,
+		guint8 *out, gsize npixels)
+{
+	guint16 prefix[LZW_MAX];
+	guint8  suffix[LZW_MAX];
+	guint8  stack[LZW_MAX+1];
+	if (min < 2 || min > 8)
+		return 0;
+	gint    clear = 1 << min, next = clear+2, size = min+1, prev = -1;
+	guint8  first = 0;
+	guint32 bits  = 0;
+	gint    nbits = 0;
+	gsize   ip = 0, op = 0;
+	for (gint i = 0; i < clear; i++) {
+		prefix[i] = 0;
+		suffix[i] = i;
+	}
+	while (op < npixels) {
+		while (nbits < size) {
+			if (ip >= len)
+				return op;
+			bits  |= in[ip++] << nbits;
+			nbits += 8;
+		}
+		gint code = bits & ((1 << size) - 1);
+		bits  >>= size;
+		nbits  -= size;
+
+		if (code == clear) {
+			next = clear+2;
+			size = min+1;
+			prev = -1;
+			continue;
+		}
+		if (code == clear+1 || code > next || (prev < 0 && code >= clear))
+			break;
+		if (prev < 0) {
+			out[op++] = first = code;
+			prev = code;
+			continue;
+		}
+
+		/* Walk the string backwards, a code that isn't in the table
+		 * yet is the previous string plus its first index */
+		gint sp = 0, cur = code;
+		if (code == next) {
+			stack[sp++] = first;
+			cur = prev;
+		}
+		while (cur >= clear) {
+			stack[sp++] = suffix[cur];
+			cur = prefix[cur];
+		}
+		stack[sp++] = first = cur;
+		while (sp > 0 && op < npixels)
+			out[op++] = stack[--sp];
+
+		if (next < LZW_MAX) {
+			prefix[next] = prev;
+			suffix[next] = first;
+			next++;
+			if (next == 1 << size && size < 12)
+				size++;
+		}
+		prev = code;
+	}
+	return op;
+}
+
+/* Place a decoded frame on the screen, undoing interlacing */
+static void _gif_place(AWeatherGif *gif, const guint8 *frame,
+		gint left, gint top, gint width, gint height, gboolean interlaced)
+{
+	static const gint starts[] = {0, 4, 2, 1}, steps[] = {8, 8, 4, 2};
+	gint row = 0;
+	for (gint pass = 0; pass < (interlaced ? 4 : 1); pass++)
+	for (gint y = interlaced ? starts[pass] : 0; y < height;
+			y += interlaced ? steps[pass] : 1, row++) {
+		if (top+y >= gif->height || left >= gif->width)
+			continue;
+		memcpy(&gif->pixels[(top+y)*gif->width + left], &frame[row*width],
+				MIN(width, gif->width - left));
+	}
+}
+
+/* Only the first frame is loaded, transparency is ignored */
+AWeatherGif *aweather_gif_load(const gchar *file)
+{
+	gchar *contents;
+	gsize  len;
+	if (!g_file_get_contents(file, &contents, &len, NULL))
+		return NULL;
+	const guint8 *data = (guint8*)contents;
+	AWeatherGif  *gif  = NULL;
+	if (len < 13 || memcmp(data, "GIF8", 4))
+		goto fail;
+
+	/* Screen descriptor */
+	gif = g_new0(AWeatherGif, 1);
+	gif->width  = data[6] | data[7]<<8;
+	gif->height = data[8] | data[9]<<8;
+	gsize pos = 13;
+	if (data[10] & 0x80 && !(pos = _gif_palette(gif, data, len, pos, data[10])))
+		goto fail;
+	if (gif->width == 0 || gif->height == 0)
+		goto fail;
+	gif->pixels = g_malloc0((gsize)gif->width*gif->height);
+
+	while (pos < len) {
+		gsize size;
+		guint8 type = data[pos++];
+		if (type == 0x21 && pos < len) {
+			/* Extension, skipped */
+			pos++;
+			g_free(_gif_blocks(data, len, &pos, &size));
+		} else if (type == 0x2C && pos + 10 <= len) {
+			/* Image descriptor */
+			gint left   = data[pos+0] | data[pos+1]<<8;
+			gint top    = data[pos+2] | data[pos+3]<<8;
+			gint width  = data[pos+4] | data[pos+5]<<8;
+			gint height = data[pos+6] | data[pos+7]<<8;
+			gint flags  = data[pos+8];
+			pos += 9;
+			if (flags & 0x80 && !(pos = _gif_palette(gif, data, len, pos, flags)))
+				goto fail;
+			if (pos >= len || gif->ncolors == 0)
+				goto fail;
+			gint    min   = data[pos++];
+			guint8 *lzw   = _gif_blocks(data, len, &pos, &size);
+			guint8 *frame = g_malloc0((gsize)width*height);
+			gsize   count = _gif_lzw(lzw, size, min, frame, (gsize)width*height);
+			if (count < (gsize)width*height)
+				g_debug("AWeatherGif: load - %s, %d of %d pixels", file,
+						(gint)count, width*height);
+			_gif_place(gif, frame, left, top, width, height, flags & 0x40);
+			g_free(frame);
+			g_free(lzw);
+			if (count == 0)
+				goto fail;
+			g_free(contents);
+			return gif;
+		} else {
+			break;
+		}
+	}
+
+fail:
+	g_debug("AWeatherGif: load - unable to load %s", file);
+	if (gif)
+		aweather_gif_free(gif);
+	g_free(contents);
+	return NULL;
+}
+
+void aweather_gif_free(AWeatherGif *gif)
+{
+	g_free(gif->pixels);
+	g_free(gif);
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2009-2012 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __AWEATHER_GIF_H__
+#define __AWEATHER_GIF_H__
+
+#include <glib.h>
+
+/* First frame of a GIF, left as palette indices */
+typedef struct {
+	gint    width, height;
+	gint    ncolors;
+	guint8  palette[256][3];
+	guint8 *pixels;         // width*height indices
+} AWeatherGif;
+
+AWeatherGif *aweather_gif_load(const gchar *file);
+
+void aweather_gif_free(AWeatherGif *gif);
+
+#endif
@@ -17,11 +17,14 @@
 
 #include <config.h>
 #include <math.h>
+#include <string.h>
+#include <unistd.h>
 #include <glib/gstdio.h>
 #include <grits.h>
 #include <rsl.h>
 
 #include "level2.h"
+#include "cappi.h"
 
 #include "../compat.h"
 
@@ -31,36 +34,36 @@
 /**************************
  * Data loading functions *
  **************************/
-/* Convert a sweep to an 2d array of data points */
-static void _bscan_sweep(Sweep *sweep, AWeatherColormap *colormap,
-		guint8 **data, int *width, int *height)
+/* Convert a sweep to an 2d array of data points
+ * bias is an optional per ray value to subtract from each gate */
+void aweather_level2_bscan(AWeatherSweep *sweep, AWeatherColormap *colormap,
+		const gfloat *bias, guint8 **data, int *width, int *height)
 {
-	g_debug("AWeatherLevel2: _bscan_sweep - %p, %p, %p",
+	g_debug("AWeatherLevel2: bscan - %p, %p, %p",
 			sweep, colormap, data);
-	/* Calculate max number of bins */
-	int max_bins = 0;
-	for (int i = 0; i < sweep->h.nrays; i++)
-		max_bins = MAX(max_bins, sweep->ray[i]->h.nbins);
-
-	/* Allocate buffer using max number of bins for each ray */
-	guint8 *buf = g_malloc0(sweep->h.nrays * max_bins * 4);
-
-	/* Fill the data */
-	for (int ri = 0; ri < sweep->h.nrays; ri++) {
-		Ray *ray  = sweep->ray[ri];
-		for (int bi = 0; bi < ray->h.nbins; bi++) {
+	/* Allocate buffer, every ray has the same number of bins */
+	int max_bins = sweep->nbins;
+	guint8 *buf = g_malloc0(sweep->nrays * max_bins * 4);
+
+	/* Fill the data
+	 * Colormap index = code*gain*scale + (offset-bias)*scale + shift */
+	for (int ri = 0; ri < sweep->nrays; ri++) {
+		gfloat shift = bias ? bias[ri] : 0;
+		gfloat a     = sweep->gain * colormap->scale;
+		gfloat b     = (sweep->offset - shift) * colormap->scale + colormap->shift;
+		for (int bi = 0; bi < sweep->nbins; bi++) {
 			guint  buf_i = (ri*max_bins+bi)*4;
-			float  value = ray->h.f(ray->range[bi]);
+			guint  code  = aweather_sweep_code(sweep, ri, bi);
 
-			/* Check for bad values */
-			if (value == BADVAL     || value == RFVAL      || value == APFLAG ||
-			    value == NOTFOUND_H || value == NOTFOUND_V || value == NOECHO) {
+			/* Codes below CODE_MIN are all bad values */
+			if (code < CODE_MIN) {
 				buf[buf_i+3] = 0x00; // transparent
 				continue;
 			}
+			int idx = code*a + b;
 
 			/* Copy color to buffer */
-			guint8 *data = colormap_get(colormap, value);
+			guint8 *data = colormap->data[CLAMP(idx, 0, colormap->len-1)];
 			buf[buf_i+0] = data[0];
 			buf[buf_i+1] = data[1];
 			buf[buf_i+2] = data[2];
@@ -70,25 +73,22 @@ static void _bscan_sweep(Sweep *sweep, AWeatherColormap *colormap,
 
 	/* set output */
 	*width  = max_bins;
-	*height = sweep->h.nrays;
+	*height = sweep->nrays;
 	*data   = buf;
 }
 
-/* Load a sweep into an OpenGL texture */
-static void _load_sweep_gl(AWeatherLevel2 *level2)
+/* Copy a b-scan into a texture, coords is the part of the texture used */
+void aweather_level2_load_tex(guint *tex, gdouble coords[2],
+		guint8 *data, gint width, gint height)
 {
-	g_debug("AWeatherLevel2: _load_sweep_gl");
-	guint8 *data;
-	gint width, height;
-	_bscan_sweep(level2->sweep, level2->sweep_colors, &data, &width, &height);
 	gint tex_width  = pow(2, ceil(log(width )/log(2)));
 	gint tex_height = pow(2, ceil(log(height)/log(2)));
-	level2->sweep_coords[0] = (double)width  / tex_width;
-	level2->sweep_coords[1] = (double)height / tex_height;
+	coords[0] = (double)width  / tex_width;
+	coords[1] = (double)height / tex_height;
 
-	if (!level2->sweep_tex)
-		 glGenTextures(1, &level2->sweep_tex);
-	glBindTexture(GL_TEXTURE_2D, level2->sweep_tex);
+	if (!*tex)
+		 glGenTextures(1, tex);
+	glBindTexture(GL_TEXTURE_2D, *tex);
 	glPixelStorei(GL_PACK_ALIGNMENT, 1);
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, tex_width, tex_height, 0,
@@ -97,8 +97,6 @@ static void _load_sweep_gl(AWeatherLevel2 *level2)
 			GL_RGBA, GL_UNSIGNED_BYTE, data);
 	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-	g_free(data);
 }
 
 /* Decompress a radar file using wsr88dec */
@@ -133,6 +131,29 @@ static gboolean _decompress_radar(const gchar *file, const gchar *raw)
 	return TRUE;
 }
 
+/* Load a sweep into an OpenGL texture */
+static void _load_sweep_gl(AWeatherLevel2 *level2)
+{
+	g_debug("AWeatherLevel2: _load_sweep_gl");
+	guint8 *data;
+	gint width, height;
+	gfloat *bias = NULL;
+	if (level2->sweep_type == SRV_INDEX && level2->motion) {
+		bias = g_new0(gfloat, level2->sweep->nrays);
+		if (!aweather_srv_bias(level2->motion, level2->sweep, bias)) {
+			g_debug("AWeatherLevel2: _load_sweep_gl - no storm motion");
+			g_free(bias);
+			bias = NULL;
+		}
+	}
+	aweather_level2_bscan(level2->sweep, level2->sweep_colors, bias,
+			&data, &width, &height);
+	g_free(bias);
+	aweather_level2_load_tex(&level2->sweep_tex, level2->sweep_coords,
+			data, width, height);
+	g_free(data);
+}
+
 /* Load the radar into a Grits Volume */
 static void _cart_to_sphere(VolCoord *out, VolCoord *in)
 {
@@ -150,42 +171,41 @@ static void _cart_to_sphere(VolCoord *out, VolCoord *in)
 	out->z = (lz*dist);
 }
 
-static VolGrid *_load_grid(Volume *vol)
+static VolGrid *_load_grid(AWeatherVolume *vol)
 {
 	g_debug("AWeatherLevel2: _load_grid");
 
-	Sweep *sweep   = vol->sweep[0];
-	Ray   *ray     = sweep->ray[0];
-	gint nsweeps   = vol->h.nsweeps;
-	gint nrays     = sweep->h.nrays/(1/sweep->h.beam_width)+1;
-	gint nbins     = ray->h.nbins  /(1000/ray->h.gate_size);
+	AWeatherSweep *sweep = vol->sweep[0];
+	gint nsweeps   = vol->nsweeps;
+	gint nrays     = sweep->nrays*sweep->beam_width+1;
+	gint nbins     = sweep->nbins/(1000/sweep->gate_size);
 	nbins = MIN(nbins, 150);
 
 	VolGrid  *grid = vol_grid_new(nrays, nbins, nsweeps);
 
-	gint rs, bs, val;
+	gint bs, val, sri;
+	guint code;
 	gint si=0, ri=0, bi=0;
 	for (si = 0; si < nsweeps; si++) {
 		sweep = vol->sweep[si];
-		rs    = 1.0/sweep->h.beam_width;
+		bs    = 1000/sweep->gate_size;
 	for (ri = 0; ri < nrays; ri++) {
-		/* TODO: missing rays, pick ri based on azmith */
-		ray   = sweep->ray[(ri*rs) % sweep->h.nrays];
-		bs    = 1000/ray->h.gate_size;
+		/* Missing rays are left empty */
+		sri   = radar_azindex_get(sweep->index, ri*360.0/(nrays-1));
+		if (sri < 0)
+			continue;
 	for (bi = 0; bi < nbins; bi++) {
-		if (bi*bs >= ray->h.nbins)
+		if (bi*bs >= sweep->nbins)
 			break;
-		val   = ray->h.f(ray->range[bi*bs]);
-		if (val == BADVAL     || val == RFVAL      ||
-		    val == APFLAG     || val == NOECHO     ||
-		    val == NOTFOUND_H || val == NOTFOUND_V ||
-		    val > 80)
+		code  = aweather_sweep_code(sweep, sri, bi*bs);
+		val   = aweather_sweep_value(sweep, code);
+		if (code < CODE_MIN || val > 80)
 			val = 0;
 		VolPoint *point = vol_grid_get(grid, ri, bi, si);
 		point->value = val;
-		point->c.x = deg2rad(ray->h.azimuth);
-		point->c.y = bi*bs*ray->h.gate_size + ray->h.range_bin1;
-		point->c.z = deg2rad(ray->h.elev);
+		point->c.x = deg2rad(sweep->azimuth[sri]);
+		point->c.y = bi*bs*sweep->gate_size + sweep->range_bin1;
+		point->c.z = deg2rad(sweep->elevs[sri]);
 	} } }
 
 	for (si = 0; si < nsweeps; si++)
@@ -204,14 +224,10 @@ static VolGrid *_load_grid(Volume *vol)
 /*********************
  * Drawing functions *
  *********************/
-void aweather_level2_draw(GritsObject *_level2, GritsOpenGL *opengl)
+/* Draw a sweep texture around the radar, in the radar's local coordinates */
+void aweather_level2_draw_sweep(AWeatherSweep *sweep, guint tex, gdouble coords[2])
 {
-	AWeatherLevel2 *level2 = AWEATHER_LEVEL2(_level2);
-	if (!level2->sweep || !level2->sweep_tex)
-		return;
-
 	/* Draw wsr88d */
-	Sweep *sweep = level2->sweep;
 	//glDisable(GL_ALPHA_TEST);
 	glDisable(GL_CULL_FACE);
 	glDisable(GL_LIGHTING);
@@ -221,41 +237,39 @@ void aweather_level2_draw(GritsObject *_level2, GritsOpenGL *opengl)
 	glColor4f(1,1,1,1);
 
 	/* Draw the rays */
-	gdouble xscale = level2->sweep_coords[0];
-	gdouble yscale = level2->sweep_coords[1];
-	glBindTexture(GL_TEXTURE_2D, level2->sweep_tex);
+	gdouble xscale = coords[0];
+	gdouble yscale = coords[1];
+	glBindTexture(GL_TEXTURE_2D, tex);
 	glBegin(GL_TRIANGLE_STRIP);
-	for (int ri = 0; ri <= sweep->h.nrays; ri++) {
-		Ray  *ray = NULL;
-		double angle = 0;
-		if (ri < sweep->h.nrays) {
-			ray = sweep->ray[ri];
-			angle = deg2rad(ray->h.azimuth - ((double)ray->h.beam_width/2.));
+	double near_dist = sweep->range_bin1 - ((double)sweep->gate_size/2.);
+	double far_dist  = near_dist + (double)sweep->nbins*sweep->gate_size;
+	for (int ri = 0; ri <= sweep->nrays; ri++) {
+		double angle = 0, elev = 0;
+		if (ri < sweep->nrays) {
+			angle = deg2rad(sweep->azimuth[ri] - ((double)sweep->beam_width/2.));
+			elev  = sweep->elevs[ri];
 		} else {
 			/* Do the right side of the last sweep */
-			ray = sweep->ray[ri-1];
-			angle = deg2rad(ray->h.azimuth + ((double)ray->h.beam_width/2.));
+			angle = deg2rad(sweep->azimuth[ri-1] + ((double)sweep->beam_width/2.));
+			elev  = sweep->elevs[ri-1];
 		}
 
 		double lx = sin(angle);
 		double ly = cos(angle);
 
-		double near_dist = ray->h.range_bin1 - ((double)ray->h.gate_size/2.);
-		double far_dist  = near_dist + (double)ray->h.nbins*ray->h.gate_size;
-
 		/* (find middle of bin) / scale for opengl */
 		// near left
-		glTexCoord2f(0.0, ((double)ri/sweep->h.nrays)*yscale);
+		glTexCoord2f(0.0, ((double)ri/sweep->nrays)*yscale);
 		glVertex3f(lx*near_dist, ly*near_dist, 2.0);
 
 		// far  left
 		// todo: correct range-height function
-		double height = sin(deg2rad(ray->h.elev)) * far_dist;
-		glTexCoord2f(xscale, ((double)ri/sweep->h.nrays)*yscale);
+		double height = sin(deg2rad(elev)) * far_dist;
+		glTexCoord2f(xscale, ((double)ri/sweep->nrays)*yscale);
 		glVertex3f(lx*far_dist,  ly*far_dist, height);
 	}
 	glEnd();
-	//g_print("ri=%d, nr=%d, bw=%f\n", _ri, sweep->h.nrays, sweep->h.beam_width);
+	//g_print("ri=%d, nr=%d, bw=%f\n", _ri, sweep->nrays, sweep->beam_width);
 
 	/* Texture debug */
 	//glBegin(GL_QUADS);
@@ -266,6 +280,35 @@ void aweather_level2_draw(GritsObject *_level2, GritsOpenGL *opengl)
 	//glEnd();
 }
 
+void aweather_level2_draw(GritsObject *_level2, GritsOpenGL *opengl)
+{
+	AWeatherLevel2 *level2 = AWEATHER_LEVEL2(_level2);
+	if (!level2->sweep || !level2->sweep_tex)
+		return;
+
+	aweather_level2_draw_sweep(level2->sweep,
+			level2->sweep_tex, level2->sweep_coords);
+
+	/* Draw cross section */
+	if (level2->slicing && level2->slice_valid)
+		aweather_xsect_draw(level2->xsect);
+}
+
+/* Pick the area covered by the radar, for probing and cross sections */
+void aweather_level2_pick(GritsObject *_level2, GritsOpenGL *opengl)
+{
+	AWeatherLevel2 *level2 = AWEATHER_LEVEL2(_level2);
+	if (!level2->sweep)
+		return;
+	AWeatherSweep *sweep = level2->sweep;
+	double dist = sweep->range_bin1 + sweep->nbins*sweep->gate_size;
+	glBegin(GL_TRIANGLE_FAN);
+	glVertex3f(0, 0, 0);
+	for (int i = 0; i <= 72; i++)
+		glVertex3f(sin(i*G_PI/36)*dist, cos(i*G_PI/36)*dist, 0);
+	glEnd();
+}
+
 void aweather_level2_hide(GritsObject *_level2, gboolean hidden)
 {
 	AWeatherLevel2 *level2 = AWEATHER_LEVEL2(_level2);
@@ -277,6 +320,29 @@ void aweather_level2_hide(GritsObject *_level2, gboolean hidden)
 /***********
  * Methods *
  ***********/
+static AWeatherColormap *_find_colormap(AWeatherLevel2 *level2, int type)
+{
+	for (int i = 0; level2->colormap[i].file; i++)
+		if (level2->colormap[i].type == type)
+			return &level2->colormap[i];
+	g_warning("AWeatherLevel2: _find_colormap - missing colormap[%d]", type);
+	return &level2->colormap[0];
+}
+
+/* Cross sections are taken from the volume the current sweep is from */
+static void _request_slice(AWeatherLevel2 *level2)
+{
+	if (!level2->xsect || !level2->slice_valid)
+		return;
+	gint type = level2->sweep_type;
+	if (type == SRV_INDEX)
+		type = VR_INDEX;
+	else if (type >= MAX_RADAR_VOLUMES)
+		type = DZ_INDEX;
+	aweather_xsect_request(level2->xsect, level2->store, type,
+			_find_colormap(level2, type), level2->slice);
+}
+
 static gboolean _set_sweep_cb(gpointer _level2)
 {
 	g_debug("AWeatherLevel2: _set_sweep_cb");
@@ -286,26 +352,137 @@ static gboolean _set_sweep_cb(gpointer _level2)
 	g_object_unref(level2);
 	return FALSE;
 }
+/* Sweeps that take a while to decode or compute are built on a thread pool
+ * shared by every level2, the current sweep stays up until they're done and
+ * set_sweep is called again */
+#define SWEEP_THREADS 2
+
+static GThreadPool *sweep_pool;
+
+typedef struct {
+	AWeatherLevel2 *level2;
+	gint            type;
+	gfloat          elev;
+	AWeatherSweep  *sweep;
+} SweepJob;
+
+static gint _cappi_key(gfloat height)
+{
+	return (gint)(height*1000 + 0.5);
+}
+
+static const gchar *_sweep_name(AWeatherLevel2 *level2, gint type)
+{
+	if (type == CAPPI_INDEX)
+		return "CAPPI";
+	if (type == SRV_INDEX)
+		type = VR_INDEX;
+	if (type < MAX_RADAR_VOLUMES && level2->store->volume[type])
+		return level2->store->volume[type]->name;
+	return "sweep";
+}
+
+static gboolean _build_sweep_cb(gpointer _job)
+{
+	SweepJob       *job    = _job;
+	AWeatherLevel2 *level2 = job->level2;
+	g_debug("AWeatherLevel2: _build_sweep_cb - %d %f", job->type, job->elev);
+	gboolean current = level2->pending_type == job->type &&
+	                   level2->pending_elev == job->elev;
+	if (current)
+		level2->pending_type = -1;
+	gpointer key = GINT_TO_POINTER(_cappi_key(job->elev));
+	if (job->sweep && g_hash_table_lookup(level2->cappi, key)) {
+		/* Built twice, the first one may be on screen already */
+		aweather_sweep_free(job->sweep);
+	} else if (job->sweep) {
+		g_hash_table_insert(level2->cappi, key, job->sweep);
+		if (current)
+			aweather_level2_set_sweep(level2, job->type, job->elev);
+	} else if (current && job->type != CAPPI_INDEX) {
+		/* The moment has been decoded */
+		aweather_level2_set_sweep(level2, job->type, job->elev);
+	}
+	if (current && level2->probe && level2->pending_type < 0)
+		gtk_label_set_text(GTK_LABEL(level2->probe), "");
+	g_object_unref(level2);
+	g_free(job);
+	return FALSE;
+}
+
+static void _build_sweep_thread(gpointer _job, gpointer _unused)
+{
+	SweepJob      *job   = _job;
+	AWeatherStore *store = job->level2->store;
+	if (job->type == CAPPI_INDEX) {
+		AWeatherVolume *volume = aweather_store_volume(store, DZ_INDEX);
+		if (volume)
+			job->sweep = aweather_cappi_sweep(volume, job->elev*1000);
+	} else {
+		aweather_store_volume(store, job->type == SRV_INDEX ? VR_INDEX : job->type);
+	}
+	g_idle_add(_build_sweep_cb, job);
+}
+
+static void _build_sweep(AWeatherLevel2 *level2, int type, float elev)
+{
+	if (level2->pending_type == type && level2->pending_elev == elev)
+		return;
+	g_debug("AWeatherLevel2: _build_sweep - %d %f", type, elev);
+	level2->pending_type = type;
+	level2->pending_elev = elev;
+	if (level2->probe) {
+		gchar *text = g_strdup_printf("Loading %s...", _sweep_name(level2, type));
+		gtk_label_set_text(GTK_LABEL(level2->probe), text);
+		g_free(text);
+	}
+	SweepJob *job = g_new0(SweepJob, 1);
+	job->level2 = g_object_ref(level2);
+	job->type   = type;
+	job->elev   = elev;
+	g_thread_pool_push(sweep_pool, job, NULL);
+}
+
 void aweather_level2_set_sweep(AWeatherLevel2 *level2,
 		int type, float elev)
 {
 	g_debug("AWeatherLevel2: set_sweep - %d %f", type, elev);
 
-	/* Find sweep */
-	Volume *volume = RSL_get_volume(level2->radar, type);
-	if (!volume) return;
-	level2->sweep = RSL_get_closest_sweep(volume, elev, 90);
-	if (!level2->sweep) return;
+	/* Find sweep, derived products use the sweeps they're computed from */
+	AWeatherSweep *sweep = NULL, *product = NULL;
+	if (type == RN1_INDEX || type == RN3_INDEX || type == RNT_INDEX) {
+		if (level2->rain)
+			sweep = product = aweather_rain_sweep(level2->rain,
+					RAIN_1HR + (type - RN1_INDEX));
+	} else if (type == CAPPI_INDEX) {
+		sweep = g_hash_table_lookup(level2->cappi,
+				GINT_TO_POINTER(_cappi_key(elev)));
+		if (!sweep) {
+			_build_sweep(level2, type, elev);
+			return;
+		}
+	} else {
+		gint vtype = type == SRV_INDEX ? VR_INDEX : type;
+		if (!aweather_store_ready(level2->store, vtype)) {
+			_build_sweep(level2, type, elev);
+			return;
+		}
+		AWeatherVolume *volume = aweather_store_volume(level2->store, vtype);
+		if (volume)
+			sweep = aweather_volume_closest(volume, elev);
+	}
+	if (!sweep) return;
+	if (level2->product)
+		aweather_sweep_free(level2->product);
+	level2->product      = product;
+	level2->pending_type = -1;
+	level2->sweep        = sweep;
+	level2->sweep_type   = type;
+	level2->sweep_elev   = elev;
 
 	/* Find colormap */
-	level2->sweep_colors = NULL;
-	for (int i = 0; level2->colormap[i].file; i++)
-		if (level2->colormap[i].type == type)
-			level2->sweep_colors = &level2->colormap[i];
-	if (!level2->sweep_colors) {
-		g_warning("AWeatherLevel2: set_sweep - missing colormap[%d]", type);
-		level2->sweep_colors = &level2->colormap[0];
-	}
+	level2->sweep_colors = _find_colormap(level2, type);
+	_request_slice(level2);
 
 	/* Load data */
 	g_object_ref(level2);
@@ -318,7 +495,9 @@ void aweather_level2_set_iso(AWeatherLevel2 *level2, gfloat level)
 
 	if (!level2->volume) {
 		g_debug("AWeatherLevel2: set_iso - creating new volume");
-		Volume      *rvol = RSL_get_volume(level2->radar, DZ_INDEX);
+		AWeatherVolume *rvol = aweather_store_volume(level2->store, DZ_INDEX);
+		if (!rvol || !rvol->nsweeps)
+			return;
 		VolGrid     *grid = _load_grid(rvol);
 		GritsVolume *vol  = grits_volume_new(grid);
 		vol->proj = GRITS_VOLUME_CARTESIAN;
@@ -341,53 +520,127 @@ void aweather_level2_set_iso(AWeatherLevel2 *level2, gfloat level)
 	}
 }
 
-AWeatherLevel2 *aweather_level2_new(Radar *radar, AWeatherColormap *colormap)
+/* Find the point on the ground under the mouse, as east and north
+ * offsets from the radar in meters */
+gboolean aweather_level2_locate(AWeatherLevel2 *level2, gdouble x, gdouble y,
+		gdouble *east, gdouble *north)
 {
-	g_debug("AWeatherLevel2: new - %s", radar->h.radar_name);
-	RSL_sort_radar(radar);
+	GritsObject *object = GRITS_OBJECT(level2);
+	GritsPoint  *center = &object->center;
+	GtkAllocation alloc;
+	gtk_widget_get_allocation(GTK_WIDGET(object->viewer), &alloc);
+
+	/* Cast a ray from the near to the far clipping plane */
+	gdouble lat, lon, elev, near[3], far[3], dir[3];
+	grits_viewer_unproject(object->viewer, x, alloc.height-y, 0, &lat, &lon, &elev);
+	lle2xyz(lat, lon, elev, &near[0], &near[1], &near[2]);
+	grits_viewer_unproject(object->viewer, x, alloc.height-y, 1, &lat, &lon, &elev);
+	lle2xyz(lat, lon, elev, &far[0], &far[1], &far[2]);
+	for (int i = 0; i < 3; i++)
+		dir[i] = far[i] - near[i];
+
+	/* Intersect it with the earth at the height of the radar */
+	gdouble radius = EARTH_R + center->elev;
+	gdouble a = dir[0]*dir[0]   + dir[1]*dir[1]   + dir[2]*dir[2];
+	gdouble b = dir[0]*near[0]  + dir[1]*near[1]  + dir[2]*near[2];
+	gdouble c = near[0]*near[0] + near[1]*near[1] + near[2]*near[2] - radius*radius;
+	gdouble disc = b*b - a*c;
+	if (a == 0 || disc < 0)
+		return FALSE;
+	gdouble t = (-b - sqrt(disc)) / a;
+	xyz2lle(near[0]+dir[0]*t, near[1]+dir[1]*t, near[2]+dir[2]*t,
+			&lat, &lon, &elev);
+
+	*north = deg2rad(lat - center->lat) * radius;
+	*east  = deg2rad(lon - center->lon) * radius * cos(deg2rad(center->lat));
+	return TRUE;
+}
+
+/* The level2 takes ownership of the store */
+AWeatherLevel2 *aweather_level2_new_from_store(AWeatherStore *store,
+		AWeatherColormap *colormap)
+{
+	g_debug("AWeatherLevel2: new_from_store - %s", store->site);
 	AWeatherLevel2 *level2 = g_object_new(AWEATHER_TYPE_LEVEL2, NULL);
-	level2->radar    = radar;
+	level2->store    = store;
 	level2->colormap = colormap;
 	aweather_level2_set_sweep(level2, DZ_INDEX, 0);
-
-	GritsPoint center;
-	Radar_header *h = &radar->h;
-	center.lat  = (double)h->latd + (double)h->latm/60 + (double)h->lats/(60*60);
-	center.lon  = (double)h->lond + (double)h->lonm/60 + (double)h->lons/(60*60);
-	center.elev = h->height;
-	GRITS_OBJECT(level2)->center = center;
+	GRITS_OBJECT(level2)->center = store->center;
 	return level2;
 }
 
-AWeatherLevel2 *aweather_level2_new_from_file(const gchar *file, const gchar *site,
-		AWeatherColormap *colormap)
+/* The radar is copied to a compact store and then freed */
+AWeatherLevel2 *aweather_level2_new(Radar *radar, AWeatherColormap *colormap)
 {
-	g_debug("AWeatherLevel2: new_from_file %s %s", site, file);
+	g_debug("AWeatherLevel2: new - %s", radar->h.radar_name);
+	RSL_sort_radar(radar);
+	AWeatherStore *store = aweather_store_new(radar);
+	RSL_free_radar(radar);
+	return aweather_level2_new_from_store(store, colormap);
+}
 
-	/* Decompress radar */
+/* Decompress a radar file next to it unless that was already done,
+ * returns the name of the decompressed file. It's decompressed to a
+ * temporary file first so a file being written by another thread is
+ * never returned. */
+gchar *aweather_level2_decompress(const gchar *file)
+{
 	gchar *raw = g_strconcat(file, ".raw", NULL);
 	if (g_file_test(raw, G_FILE_TEST_EXISTS)) {
 		struct stat files, raws;
 		g_stat(file, &files);
 		g_stat(raw,  &raws);
-		if (files.st_mtime > raws.st_mtime)
-			if (!_decompress_radar(file, raw))
-				return NULL;
-	} else {
-		if (!_decompress_radar(file, raw))
-			return NULL;
+		if (files.st_mtime <= raws.st_mtime)
+			return raw;
 	}
+	gchar *tmp = g_strconcat(raw, ".XXXXXX", NULL);
+	gint   fd  = g_mkstemp(tmp);
+	if (fd >= 0)
+		close(fd);
+	if (fd < 0 || !_decompress_radar(file, tmp) || g_rename(tmp, raw) != 0) {
+		if (fd >= 0)
+			g_remove(tmp);
+		g_free(tmp);
+		g_free(raw);
+		return NULL;
+	}
+	g_free(tmp);
+	return raw;
+}
 
-	/* Load the radar file */
-	RSL_read_these_sweeps("all", NULL);
-	g_debug("AWeatherLevel2: rsl read start");
-	Radar *radar = RSL_wsr88d_to_radar(raw, (gchar*)site);
-	g_debug("AWeatherLevel2: rsl read done");
-	g_free(raw);
-	if (!radar)
+/* Decompress a downloaded file and load it into a store, reusing the cache
+ * from an earlier load if the file hasn't changed. Moments other than
+ * reflectivity are decoded when they are first used */
+AWeatherStore *aweather_level2_load(const gchar *file, const gchar *site)
+{
+	g_debug("AWeatherLevel2: load %s %s", site, file);
+
+	/* Decompress radar */
+	gchar *raw = aweather_level2_decompress(file);
+	if (!raw)
 		return NULL;
 
-	return aweather_level2_new(radar, colormaps);
+	/* Load from the cache, or the radar file saving it for next time */
+	gchar *cache = g_strconcat(file, ".store", NULL);
+	AWeatherStore *store = aweather_store_new_from_cache(cache, file, raw);
+	if (!store) {
+		store = aweather_store_new_from_file(raw, site);
+		if (store)
+			aweather_store_save(store, cache, file);
+	}
+	g_free(cache);
+	g_free(raw);
+	return store;
+}
+
+AWeatherLevel2 *aweather_level2_new_from_file(const gchar *file, const gchar *site,
+		AWeatherColormap *colormap)
+{
+	g_debug("AWeatherLevel2: new_from_file %s %s", site, file);
+	AWeatherStore *store = aweather_level2_load(file, site);
+	if (!store)
+		return NULL;
+	return aweather_level2_new_from_store(store, colormaps);
 }
 
 static void _on_sweep_clicked(GtkRadioButton *button, gpointer _level2)
@@ -401,6 +654,136 @@ static void _on_sweep_clicked(GtkRadioButton *button, gpointer _level2)
 	}
 }
 
+static void _on_rain_reset(GtkButton *button, gpointer _level2)
+{
+	AWeatherLevel2 *level2 = _level2;
+	aweather_rain_reset(level2->rain);
+	aweather_rain_save(level2->rain);
+	if (level2->sweep_type == RNT_INDEX)
+		aweather_level2_set_sweep(level2, RNT_INDEX, 0);
+}
+
+static void _on_slice_toggled(GtkToggleButton *button, gpointer _level2)
+{
+	AWeatherLevel2 *level2 = _level2;
+	level2->slicing = gtk_toggle_button_get_active(button);
+	if (level2->slicing && !level2->xsect) {
+		level2->xsect = aweather_xsect_new(GRITS_OBJECT(level2));
+		grits_object_set_cursor(GRITS_OBJECT(level2), GDK_CROSSHAIR);
+	}
+	if (!level2->slicing && level2->xsect) {
+		level2->slice_drag  = FALSE;
+		level2->slice_valid = FALSE;
+		aweather_xsect_clear(level2->xsect);
+	}
+	grits_object_queue_draw(GRITS_OBJECT(level2));
+}
+
+/* Find the value under the mouse. This runs on every motion event so it
+ * only uses the azimuth index and gate arithmetic. */
+static void _probe(AWeatherLevel2 *level2, gdouble east, gdouble north,
+		gchar *text, gsize len)
+{
+	AWeatherSweep *sweep = level2->sweep;
+	gint    type   = level2->sweep_type;
+	gdouble dist   = hypot(east, north);
+	gdouble az     = fmod(rad2deg(atan2(east, north)) + 360, 360);
+	gdouble height = 0, range = dist;
+	gint    ri     = radar_azindex_get(sweep->index, az);
+	if (ri < 0)
+		return;
+
+	/* Products are on flat grids with ground ranges */
+	if (type < MAX_RADAR_VOLUMES || type == SRV_INDEX)
+		beam_height(dist, sweep->elevs[ri], &height, &range);
+	else if (type == CAPPI_INDEX)
+		height = level2->sweep_elev * 1000;
+
+	gint bi = floor((range - sweep->range_bin1) / sweep->gate_size + 0.5);
+	if (bi < 0 || bi >= sweep->nbins)
+		return;
+	guint code  = aweather_sweep_code(sweep, ri, bi);
+	float value = aweather_sweep_value(sweep, code);
+	gint  pos   = g_snprintf(text, len, "%.0f° %.1f km", az, range/1000);
+	if (type != RN1_INDEX && type != RN3_INDEX && type != RNT_INDEX)
+		pos += g_snprintf(text+pos, len-pos, ", %.1f km high", height/1000);
+	if (code < CODE_MIN) {
+		g_snprintf(text+pos, len-pos, ": no data");
+		return;
+	}
+	gfloat u, v;
+	if (type == SRV_INDEX && level2->motion &&
+	    aweather_motion_uv(level2->motion, &u, &v))
+		value -= u * sin(deg2rad(sweep->azimuth[ri])) +
+		         v * cos(deg2rad(sweep->azimuth[ri]));
+	g_snprintf(text+pos, len-pos, ": %.1f %s", value, level2->sweep_colors->units);
+}
+
+static gboolean _on_probe_motion(GritsObject *object, GdkEvent *_event, gpointer _level2)
+{
+	AWeatherLevel2 *level2 = _level2;
+	GdkEventMotion *event  = (GdkEventMotion*)_event;
+	gchar   text[128] = "";
+	gdouble east, north;
+	if (!level2->probe || !level2->sweep)
+		return FALSE;
+	if (level2->pending_type >= 0)
+		g_snprintf(text, sizeof(text), "Loading %s...",
+				_sweep_name(level2, level2->pending_type));
+	else if (aweather_level2_locate(level2, event->x, event->y, &east, &north))
+		_probe(level2, east, north, text, sizeof(text));
+	if (strcmp(text, gtk_label_get_text(GTK_LABEL(level2->probe))))
+		gtk_label_set_text(GTK_LABEL(level2->probe), text);
+	return FALSE;
+}
+
+static void _on_probe_leave(GritsObject *object, gpointer _level2)
+{
+	AWeatherLevel2 *level2 = _level2;
+	if (level2->probe)
+		gtk_label_set_text(GTK_LABEL(level2->probe), "");
+}
+
+static gboolean _on_slice_press(GritsObject *object, GdkEvent *_event, gpointer _level2)
+{
+	AWeatherLevel2 *level2 = _level2;
+	GdkEventButton *event  = (GdkEventButton*)_event;
+	gdouble east, north;
+	if (!level2->slicing || event->button != 1 ||
+	    !aweather_level2_locate(level2, event->x, event->y, &east, &north))
+		return FALSE;
+	level2->slice[0] = level2->slice[2] = east;
+	level2->slice[1] = level2->slice[3] = north;
+	level2->slice_drag  = TRUE;
+	level2->slice_valid = TRUE;
+	return TRUE;
+}
+
+static gboolean _on_slice_motion(GritsObject *object, GdkEvent *_event, gpointer _level2)
+{
+	AWeatherLevel2 *level2 = _level2;
+	GdkEventMotion *event  = (GdkEventMotion*)_event;
+	gdouble east, north;
+	if (!level2->slice_drag)
+		return FALSE;
+	if (aweather_level2_locate(level2, event->x, event->y, &east, &north)) {
+		level2->slice[2] = east;
+		level2->slice[3] = north;
+		_request_slice(level2);
+		grits_object_queue_draw(object);
+	}
+	return TRUE;
+}
+
+static gboolean _on_slice_release(GritsObject *object, GdkEvent *_event, gpointer _level2)
+{
+	AWeatherLevel2 *level2 = _level2;
+	if (!level2->slice_drag)
+		return FALSE;
+	level2->slice_drag = FALSE;
+	return TRUE;
+}
+
 static void _on_iso_changed(GtkRange *range, gpointer _level2)
 {
 	AWeatherLevel2 *level2 = _level2;
@@ -413,85 +796,237 @@ static gchar *_on_format_value(GtkScale *scale, gdouble value, gpointer _level2)
 	return g_strdup_printf("%.1lf dBZ ", value);
 }
 
+static void _on_motion_changed(GtkSpinButton *spin, gpointer _level2)
+{
+	AWeatherLevel2 *level2 = _level2;
+	GtkWidget *box   = gtk_widget_get_parent(GTK_WIDGET(spin));
+	GtkWidget *dir   = g_object_get_data(G_OBJECT(box), "dir");
+	GtkWidget *speed = g_object_get_data(G_OBJECT(box), "speed");
+	aweather_motion_set(level2->motion,
+			gtk_spin_button_get_value(GTK_SPIN_BUTTON(dir)),
+			gtk_spin_button_get_value(GTK_SPIN_BUTTON(speed)));
+	if (level2->sweep_type == SRV_INDEX)
+		aweather_level2_set_sweep(level2, SRV_INDEX, level2->sweep_elev);
+}
+
+/* Add a row of buttons for each elevation in a volume, this only uses
+ * the tilts so the moment is not decoded until a button is clicked */
+static void _add_sweep_row(GtkWidget *table, AWeatherLevel2 *level2,
+		AWeatherVolume *vol, gint type, const gchar *name,
+		guint *rows, GtkWidget **button)
+{
+	gfloat elev = 0;
+	guint cols = 1, cur_cols;
+	gchar row_label_str[64], col_label_str[64], button_str[64];
+	GtkWidget *row_label, *col_label, *elev_box = NULL;
+	(*rows)++;
+
+	/* Row label */
+	g_snprintf(row_label_str, 64, "<b>%s:</b>", name);
+	row_label = gtk_label_new(row_label_str);
+	gtk_label_set_use_markup(GTK_LABEL(row_label), TRUE);
+	gtk_misc_set_alignment(GTK_MISC(row_label), 1, 0.5);
+	gtk_table_attach(GTK_TABLE(table), row_label,
+			0,1, *rows-1,*rows, GTK_FILL,GTK_FILL, 5,0);
+
+	for (guint ti = 0; ti < vol->ntilts; ti++) {
+		if (vol->tilts[ti] == 0) continue;
+		if (vol->tilts[ti] != elev) {
+			cols++;
+			elev = vol->tilts[ti];
+
+			/* Column label */
+			g_object_get(table, "n-columns", &cur_cols, NULL);
+			if (cols >  cur_cols) {
+				g_snprintf(col_label_str, 64, "<b>%.2f°</b>", elev);
+				col_label = gtk_label_new(col_label_str);
+				gtk_label_set_use_markup(GTK_LABEL(col_label), TRUE);
+				gtk_widget_set_size_request(col_label, 50, -1);
+				gtk_table_attach(GTK_TABLE(table), col_label,
+						cols-1,cols, 0,1, GTK_FILL,GTK_FILL, 0,0);
+			}
+
+			elev_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
+			gtk_box_set_homogeneous(GTK_BOX(elev_box), TRUE);
+			gtk_table_attach(GTK_TABLE(table), elev_box,
+					cols-1,cols, *rows-1,*rows, GTK_FILL,GTK_FILL, 0,0);
+		}
+
+
+		/* Button */
+		g_snprintf(button_str, 64, "%3.2f", elev);
+		*button = gtk_radio_button_new_with_label_from_widget(
+				GTK_RADIO_BUTTON(*button), button_str);
+		gtk_widget_set_size_request(*button, -1, 26);
+		//button = gtk_radio_button_new_from_widget(GTK_RADIO_BUTTON(button));
+		//gtk_widget_set_size_request(button, -1, 22);
+		g_object_set(*button, "draw-indicator", FALSE, NULL);
+		gtk_box_pack_end(GTK_BOX(elev_box), *button, TRUE, TRUE, 0);
+
+		g_object_set_data(G_OBJECT(*button), "level2", level2);
+		g_object_set_data(G_OBJECT(*button), "type", (gpointer)(guintptr)type);
+		g_object_set_data(G_OBJECT(*button), "elev", (gpointer)(guintptr)(elev*100));
+		g_signal_connect(*button, "clicked", G_CALLBACK(_on_sweep_clicked), level2);
+	}
+}
+
 GtkWidget *aweather_level2_get_config(AWeatherLevel2 *level2)
 {
-	Radar *radar = level2->radar;
-	g_debug("AWeatherLevel2: get_config - %p, %p", level2, radar);
+	AWeatherStore *store = level2->store;
+	g_debug("AWeatherLevel2: get_config - %p, %p", level2, store);
 	/* Clear existing items */
-	gfloat elev;
-	guint rows = 1, cols = 1, cur_cols;
-	gchar row_label_str[64], col_label_str[64], button_str[64];
-	GtkWidget *row_label, *col_label, *button = NULL, *elev_box = NULL;
+	guint rows = 1, cols = 1;
+	GtkWidget *row_label, *button = NULL;
 	GtkWidget *table = gtk_table_new(rows, cols, FALSE);
 
 	/* Add date */
-	gchar *date_str = g_strdup_printf("<b><i>%04d-%02d-%02d %02d:%02d</i></b>",
-			radar->h.year, radar->h.month, radar->h.day,
-			radar->h.hour, radar->h.minute);
+	GDateTime *date = g_date_time_new_from_unix_utc(store->time);
+	gchar *date_str = g_date_time_format(date, "<b><i>%Y-%m-%d %H:%M</i></b>");
 	GtkWidget *date_label = gtk_label_new(date_str);
 	gtk_label_set_use_markup(GTK_LABEL(date_label), TRUE);
 	gtk_table_attach(GTK_TABLE(table), date_label,
 			0,1, 0,1, GTK_FILL,GTK_FILL, 5,0);
+	g_date_time_unref(date);
 	g_free(date_str);
 
 	/* Add sweeps */
-	for (guint vi = 0; vi < radar->h.nvolumes; vi++) {
-		Volume *vol = radar->v[vi];
+	for (guint vi = 0; vi < MAX_RADAR_VOLUMES; vi++) {
+		AWeatherVolume *vol = store->volume[vi];
 		if (vol == NULL) continue;
-		rows++; cols = 1; elev = 0;
+		_add_sweep_row(table, level2, vol, vi, vol->name,
+				&rows, &button);
+	}
 
-		/* Row label */
-		g_snprintf(row_label_str, 64, "<b>%s:</b>", vol->h.type_str);
-		row_label = gtk_label_new(row_label_str);
+	/* Add storm relative velocity */
+	AWeatherVolume *vel = store->volume[VR_INDEX];
+	if (vel && level2->motion)
+		_add_sweep_row(table, level2, vel, SRV_INDEX, "SRV",
+				&rows, &button);
+	g_object_get(table, "n-columns", &cols, NULL);
+
+	/* Add constant altitude reflectivity, elev is the height in km */
+	if (store->volume[DZ_INDEX]) {
+		static const gint heights[] = {1, 2, 3, 4, 5, 6, 8, 10};
+		row_label = gtk_label_new("<b>CAPPI:</b>");
 		gtk_label_set_use_markup(GTK_LABEL(row_label), TRUE);
 		gtk_misc_set_alignment(GTK_MISC(row_label), 1, 0.5);
 		gtk_table_attach(GTK_TABLE(table), row_label,
-				0,1, rows-1,rows, GTK_FILL,GTK_FILL, 5,0);
-
-		for (guint si = 0; si < vol->h.nsweeps; si++) {
-			Sweep *sweep = vol->sweep[si];
-			if (sweep == NULL || sweep->h.elev == 0) continue;
-			if (sweep->h.elev != elev) {
-				cols++;
-				elev = sweep->h.elev;
-
-				/* Column label */
-				g_object_get(table, "n-columns", &cur_cols, NULL);
-				if (cols >  cur_cols) {
-					g_snprintf(col_label_str, 64, "<b>%.2f°</b>", elev);
-					col_label = gtk_label_new(col_label_str);
-					gtk_label_set_use_markup(GTK_LABEL(col_label), TRUE);
-					gtk_widget_set_size_request(col_label, 50, -1);
-					gtk_table_attach(GTK_TABLE(table), col_label,
-							cols-1,cols, 0,1, GTK_FILL,GTK_FILL, 0,0);
-				}
-
-				elev_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
-				gtk_box_set_homogeneous(GTK_BOX(elev_box), TRUE);
-				gtk_table_attach(GTK_TABLE(table), elev_box,
-						cols-1,cols, rows-1,rows, GTK_FILL,GTK_FILL, 0,0);
-			}
-
-
-			/* Button */
-			g_snprintf(button_str, 64, "%3.2f", elev);
+				0,1, rows,rows+1, GTK_FILL,GTK_FILL, 5,0);
+		GtkWidget *box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
+		for (int i = 0; i < G_N_ELEMENTS(heights); i++) {
+			gchar *label = g_strdup_printf("%d km", heights[i]);
 			button = gtk_radio_button_new_with_label_from_widget(
-					GTK_RADIO_BUTTON(button), button_str);
-			gtk_widget_set_size_request(button, -1, 26);
-			//button = gtk_radio_button_new_from_widget(GTK_RADIO_BUTTON(button));
-			//gtk_widget_set_size_request(button, -1, 22);
+					GTK_RADIO_BUTTON(button), label);
+			gtk_widget_set_size_request(button, 50, 26);
 			g_object_set(button, "draw-indicator", FALSE, NULL);
-			gtk_box_pack_end(GTK_BOX(elev_box), button, TRUE, TRUE, 0);
+			gtk_box_pack_start(GTK_BOX(box), button, FALSE, FALSE, 0);
+			g_object_set_data(G_OBJECT(button), "level2", level2);
+			g_object_set_data(G_OBJECT(button), "type", (gpointer)(guintptr)CAPPI_INDEX);
+			g_object_set_data(G_OBJECT(button), "elev", (gpointer)(guintptr)(heights[i]*100));
+			g_signal_connect(button, "clicked", G_CALLBACK(_on_sweep_clicked), level2);
+			g_free(label);
+		}
+		gtk_table_attach(GTK_TABLE(table), box,
+				1,cols+1, rows,rows+1, GTK_FILL,GTK_FILL, 0,0);
+		rows++;
+	}
 
+	/* Add rainfall accumulation */
+	if (level2->rain) {
+		static const struct { gint type; gchar *label; } periods[] = {
+			{RN1_INDEX, "1 h"}, {RN3_INDEX, "3 h"}, {RNT_INDEX, "Total"},
+		};
+		row_label = gtk_label_new("<b>Rain:</b>");
+		gtk_label_set_use_markup(GTK_LABEL(row_label), TRUE);
+		gtk_misc_set_alignment(GTK_MISC(row_label), 1, 0.5);
+		gtk_table_attach(GTK_TABLE(table), row_label,
+				0,1, rows,rows+1, GTK_FILL,GTK_FILL, 5,0);
+		GtkWidget *box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
+		for (int i = 0; i < G_N_ELEMENTS(periods); i++) {
+			button = gtk_radio_button_new_with_label_from_widget(
+					GTK_RADIO_BUTTON(button), periods[i].label);
+			gtk_widget_set_size_request(button, 50, 26);
+			g_object_set(button, "draw-indicator", FALSE, NULL);
+			gtk_box_pack_start(GTK_BOX(box), button, FALSE, FALSE, 0);
 			g_object_set_data(G_OBJECT(button), "level2", level2);
-			g_object_set_data(G_OBJECT(button), "type", (gpointer)(guintptr)vi);
-			g_object_set_data(G_OBJECT(button), "elev", (gpointer)(guintptr)(elev*100));
+			g_object_set_data(G_OBJECT(button), "type", (gpointer)(guintptr)periods[i].type);
+			g_object_set_data(G_OBJECT(button), "elev", (gpointer)(guintptr)0);
 			g_signal_connect(button, "clicked", G_CALLBACK(_on_sweep_clicked), level2);
 		}
+		GtkWidget *reset = gtk_button_new_with_label("Reset");
+		gtk_widget_set_size_request(reset, -1, 26);
+		g_signal_connect(reset, "clicked", G_CALLBACK(_on_rain_reset), level2);
+		gtk_box_pack_start(GTK_BOX(box), reset, FALSE, FALSE, 5);
+		gtk_table_attach(GTK_TABLE(table), box,
+				1,cols+1, rows,rows+1, GTK_FILL,GTK_FILL, 0,0);
+		rows++;
 	}
 
+	/* Add storm motion */
+	if (vel && level2->motion) {
+		/* Without a motion SRV is the same as the velocity */
+		gfloat dir = 0, speed = 0;
+		gboolean valid = aweather_motion_get(level2->motion, &dir, &speed);
+		const gchar *units = !valid ? "m/s (not tracked, showing velocity)" :
+			level2->motion->user ? "m/s" : "m/s (tracked)";
+		row_label = gtk_label_new("<b>Motion:</b>");
+		gtk_label_set_use_markup(GTK_LABEL(row_label), TRUE);
+		gtk_misc_set_alignment(GTK_MISC(row_label), 1, 0.5);
+		gtk_table_attach(GTK_TABLE(table), row_label,
+				0,1, rows,rows+1, GTK_FILL,GTK_FILL, 5,0);
+		GtkWidget *box       = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
+		GtkWidget *dir_spin  = gtk_spin_button_new_with_range(0, 359, 5);
+		GtkWidget *spd_spin  = gtk_spin_button_new_with_range(0, 60,  1);
+		gtk_spin_button_set_wrap(GTK_SPIN_BUTTON(dir_spin), TRUE);
+		gtk_spin_button_set_value(GTK_SPIN_BUTTON(dir_spin), round(dir));
+		gtk_spin_button_set_value(GTK_SPIN_BUTTON(spd_spin), round(speed));
+		gtk_box_pack_start(GTK_BOX(box), dir_spin, FALSE, FALSE, 0);
+		gtk_box_pack_start(GTK_BOX(box), gtk_label_new("°"), FALSE, FALSE, 0);
+		gtk_box_pack_start(GTK_BOX(box), spd_spin, FALSE, FALSE, 0);
+		gtk_box_pack_start(GTK_BOX(box), gtk_label_new(units), FALSE, FALSE, 0);
+		g_object_set_data(G_OBJECT(box), "dir",   dir_spin);
+		g_object_set_data(G_OBJECT(box), "speed", spd_spin);
+		g_signal_connect(dir_spin, "value-changed", G_CALLBACK(_on_motion_changed), level2);
+		g_signal_connect(spd_spin, "value-changed", G_CALLBACK(_on_motion_changed), level2);
+		gtk_table_attach(GTK_TABLE(table), box,
+				1,cols+1, rows,rows+1, GTK_FILL,GTK_FILL, 0,0);
+		rows++;
+	}
+
+	/* Add cross section */
+	row_label = gtk_label_new("<b>Slice:</b>");
+	gtk_label_set_use_markup(GTK_LABEL(row_label), TRUE);
+	gtk_misc_set_alignment(GTK_MISC(row_label), 1, 0.5);
+	gtk_table_attach(GTK_TABLE(table), row_label,
+			0,1, rows,rows+1, GTK_FILL,GTK_FILL, 5,0);
+	GtkWidget *slice_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
+	GtkWidget *slice = gtk_toggle_button_new_with_label("Draw");
+	gtk_widget_set_size_request(slice, 50, 26);
+	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(slice), level2->slicing);
+	g_signal_connect(slice, "toggled", G_CALLBACK(_on_slice_toggled), level2);
+	gtk_box_pack_start(GTK_BOX(slice_box), slice, FALSE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(slice_box),
+			gtk_label_new("drag a line across the radar"), FALSE, FALSE, 0);
+	gtk_table_attach(GTK_TABLE(table), slice_box,
+			1,cols+1, rows,rows+1, GTK_FILL,GTK_FILL, 0,0);
+	rows++;
+
+	/* Add data probe */
+	row_label = gtk_label_new("<b>Probe:</b>");
+	gtk_label_set_use_markup(GTK_LABEL(row_label), TRUE);
+	gtk_misc_set_alignment(GTK_MISC(row_label), 1, 0.5);
+	gtk_table_attach(GTK_TABLE(table), row_label,
+			0,1, rows,rows+1, GTK_FILL,GTK_FILL, 5,0);
+	level2->probe = gtk_label_new("");
+	gtk_misc_set_alignment(GTK_MISC(level2->probe), 0, 0.5);
+	gtk_widget_set_size_request(level2->probe, -1, 26);
+	g_signal_connect(level2->probe, "destroy",
+			G_CALLBACK(gtk_widget_destroyed), &level2->probe);
+	gtk_table_attach(GTK_TABLE(table), level2->probe,
+			1,cols+1, rows,rows+1, GTK_FILL,GTK_FILL, 0,0);
+	rows++;
+
 	/* Add Iso-surface volume */
-	g_object_get(table, "n-columns", &cols, NULL);
 	row_label = gtk_label_new("<b>Isosurface:</b>");
 	gtk_label_set_use_markup(GTK_LABEL(row_label), TRUE);
 	gtk_misc_set_alignment(GTK_MISC(row_label), 1, 0.5);
@@ -518,19 +1053,34 @@ GtkWidget *aweather_level2_get_config(AWeatherLevel2 *level2)
 G_DEFINE_TYPE(AWeatherLevel2, aweather_level2, GRITS_TYPE_OBJECT);
 static void aweather_level2_init(AWeatherLevel2 *level2)
 {
+	level2->cappi        = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+			NULL, (GDestroyNotify)aweather_sweep_free);
+	level2->pending_type = -1;
+	g_signal_connect(level2, "motion",         G_CALLBACK(_on_probe_motion),  level2);
+	g_signal_connect(level2, "leave",          G_CALLBACK(_on_probe_leave),   level2);
+	g_signal_connect(level2, "button-press",   G_CALLBACK(_on_slice_press),   level2);
+	g_signal_connect(level2, "motion",         G_CALLBACK(_on_slice_motion),  level2);
+	g_signal_connect(level2, "button-release", G_CALLBACK(_on_slice_release), level2);
 }
 static void aweather_level2_dispose(GObject *_level2)
 {
 	AWeatherLevel2 *level2 = AWEATHER_LEVEL2(_level2);
 	g_debug("AWeatherLevel2: dispose - %p", _level2);
 	grits_object_destroy_pointer(&level2->volume);
+	if (level2->xsect) {
+		aweather_xsect_free(level2->xsect);
+		level2->xsect = NULL;
+	}
 	G_OBJECT_CLASS(aweather_level2_parent_class)->dispose(_level2);
 }
 static void aweather_level2_finalize(GObject *_level2)
 {
 	AWeatherLevel2 *level2 = AWEATHER_LEVEL2(_level2);
 	g_debug("AWeatherLevel2: finalize - %p", _level2);
-	RSL_free_radar(level2->radar);
+	if (level2->product)
+		aweather_sweep_free(level2->product);
+	g_hash_table_destroy(level2->cappi);
+	aweather_store_free(level2->store);
 	if (level2->sweep_tex)
 		glDeleteTextures(1, &level2->sweep_tex);
 	G_OBJECT_CLASS(aweather_level2_parent_class)->finalize(_level2);
@@ -540,5 +1090,8 @@ static void aweather_level2_class_init(AWeatherLevel2Class *klass)
 	G_OBJECT_CLASS(klass)->dispose  = aweather_level2_dispose;
 	G_OBJECT_CLASS(klass)->finalize = aweather_level2_finalize;
 	GRITS_OBJECT_CLASS(klass)->draw = aweather_level2_draw;
+	GRITS_OBJECT_CLASS(klass)->pick = aweather_level2_pick;
 	GRITS_OBJECT_CLASS(klass)->hide = aweather_level2_hide;
+	sweep_pool = g_thread_pool_new(_build_sweep_thread, NULL,
+			SWEEP_THREADS, FALSE, NULL);
 }
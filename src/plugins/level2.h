@@ -20,6 +20,10 @@
 
 #include <grits.h>
 #include "radar-info.h"
+#include "store.h"
+#include "srv.h"
+#include "rain.h"
+#include "xsect.h"
 
 /* Level2 */
 #define AWEATHER_TYPE_LEVEL2            (aweather_level2_get_type())
@@ -34,15 +38,29 @@ typedef struct _AWeatherLevel2Class AWeatherLevel2Class;
 
 struct _AWeatherLevel2 {
 	GritsObject       parent;
-	Radar            *radar;
+	AWeatherStore    *store;
 	AWeatherColormap *colormap;
+	AWeatherMotion   *motion;
+	AWeatherRain     *rain;
 
 	/* Private */
 	GritsVolume      *volume;
-	Sweep            *sweep;
+	AWeatherSweep    *sweep;
+	AWeatherSweep    *product;
+	GHashTable       *cappi;        // CAPPI sweeps by height in meters
+	gint              pending_type; // Sweep being built on a thread, or -1
+	gfloat            pending_elev;
+	gint              sweep_type;
+	gfloat            sweep_elev;
 	AWeatherColormap *sweep_colors;
 	gdouble           sweep_coords[2];
 	guint             sweep_tex;
+	GtkWidget        *probe;
+	AWeatherXsect    *xsect;
+	gboolean          slicing;
+	gboolean          slice_drag;
+	gboolean          slice_valid;
+	gdouble           slice[4];
 };
 
 struct _AWeatherLevel2Class {
@@ -53,14 +71,33 @@ GType aweather_level2_get_type(void);
 
 AWeatherLevel2 *aweather_level2_new(Radar *radar, AWeatherColormap *colormap);
 
+AWeatherLevel2 *aweather_level2_new_from_store(AWeatherStore *store,
+		AWeatherColormap *colormap);
+
 AWeatherLevel2 *aweather_level2_new_from_file(const gchar *file, const gchar *site,
 		AWeatherColormap *colormap);
 
+gchar *aweather_level2_decompress(const gchar *file);
+
+AWeatherStore *aweather_level2_load(const gchar *file, const gchar *site);
+
 void aweather_level2_set_sweep(AWeatherLevel2 *level2,
 		int type, gfloat elev);
 
 void aweather_level2_set_iso(AWeatherLevel2 *level2, gfloat level);
 
+/* Sweep drawing, also used for animation frames */
+void aweather_level2_bscan(AWeatherSweep *sweep, AWeatherColormap *colormap,
+		const gfloat *bias, guint8 **data, int *width, int *height);
+
+void aweather_level2_load_tex(guint *tex, gdouble coords[2],
+		guint8 *data, gint width, gint height);
+
+void aweather_level2_draw_sweep(AWeatherSweep *sweep, guint tex, gdouble coords[2]);
+
+gboolean aweather_level2_locate(AWeatherLevel2 *level2, gdouble x, gdouble y,
+		gdouble *east, gdouble *north);
+
 GtkWidget *aweather_level2_get_config(AWeatherLevel2 *level2);
 
 #endif
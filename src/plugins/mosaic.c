@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) 2009-2012 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <math.h>
+#include <string.h>
+#include <grits.h>
+
+#include "radar-info.h"
+#include "mosaic.h"
+
+/*********
+ * Sites *
+ *********/
+static void _site_free(MosaicSite *site)
+{
+	g_free(site->entries);
+	g_free(site->values);
+	g_free(site->code);
+	g_free(site);
+}
+
+static gboolean _site_matches(MosaicSite *site, AWeatherSweep *sweep)
+{
+	return site->entries          &&
+	       site->nrays      == sweep->nrays      &&
+	       site->nbins      == sweep->nbins      &&
+	       site->range_bin1 == sweep->range_bin1 &&
+	       site->gate_size  == sweep->gate_size  &&
+	       site->elev       == sweep->elev;
+}
+
+/* Find the gate over the center of every cell in range of the radar. Ray
+ * azimuths only drift by a fraction of the beam width between volumes, so
+ * the table is kept until the sweep geometry changes. */
+static void _site_table(MosaicSite *site, AWeatherSweep *sweep)
+{
+	g_debug("AWeatherMosaic: table - %s", site->code);
+	if (!sweep->index)
+		aweather_sweep_index(sweep);
+	site->nrays      = sweep->nrays;
+	site->nbins      = sweep->nbins;
+	site->range_bin1 = sweep->range_bin1;
+	site->gate_size  = sweep->gate_size;
+	site->elev       = sweep->elev;
+
+	/* Cells that could be in range */
+	gdouble range = sweep->range_bin1 + sweep->nbins*sweep->gate_size;
+	gdouble dlat  = range / EARTH_R * 180/G_PI;
+	gdouble dlon  = dlat / MAX(cos(deg2rad(site->lat)), 0.1);
+	gint    row0  = floor((MOSAIC_NORTH - site->lat - dlat) / MOSAIC_DEG);
+	gint    row1  = ceil ((MOSAIC_NORTH - site->lat + dlat) / MOSAIC_DEG);
+	gint    col0  = floor((site->lon - dlon - MOSAIC_WEST)  / MOSAIC_DEG);
+	gint    col1  = ceil ((site->lon + dlon - MOSAIC_WEST)  / MOSAIC_DEG);
+
+	gdouble phi1 = deg2rad(site->lat);
+	GArray *entries = g_array_new(FALSE, FALSE, sizeof(MosaicEntry));
+	for (gint ti = 0; ti < MOSAIC_TILES; ti++) {
+		site->start[ti] = entries->len;
+		gint trow = (ti / MOSAIC_COLS) * MOSAIC_TILE;
+		gint tcol = (ti % MOSAIC_COLS) * MOSAIC_TILE;
+		for (gint row = MAX(row0, trow); row < MIN(row1, trow+MOSAIC_TILE); row++)
+		for (gint col = MAX(col0, tcol); col < MIN(col1, tcol+MOSAIC_TILE); col++) {
+			gdouble lat  = MOSAIC_NORTH - (row+0.5)*MOSAIC_DEG;
+			gdouble lon  = MOSAIC_WEST  + (col+0.5)*MOSAIC_DEG;
+			gdouble phi2 = deg2rad(lat);
+			gdouble dl   = deg2rad(lon - site->lon);
+			gdouble c    = sin(phi1)*sin(phi2) + cos(phi1)*cos(phi2)*cos(dl);
+			gdouble dist = EARTH_R * acos(CLAMP(c, -1, 1));
+			gdouble az   = atan2(sin(dl)*cos(phi2),
+				cos(phi1)*sin(phi2) - sin(phi1)*cos(phi2)*cos(dl)) * 180/G_PI;
+			gdouble height, slant;
+			beam_height(dist, sweep->elev, &height, &slant);
+			gint ri = radar_azindex_get(sweep->index, az);
+			gint bi = floor((slant - sweep->range_bin1) / sweep->gate_size + 0.5);
+			if (ri < 0 || bi < 0 || bi >= sweep->nbins)
+				continue;
+			MosaicEntry entry = {
+				.cell = (row-trow)*MOSAIC_TILE + (col-tcol),
+				.dist = MIN(dist/100, G_MAXUINT16),
+				.gate = ri*sweep->nbins + bi,
+			};
+			g_array_append_val(entries, entry);
+		}
+	}
+	site->start[MOSAIC_TILES] = entries->len;
+
+	g_free(site->entries);
+	g_free(site->values);
+	site->values  = g_malloc0(entries->len);
+	site->entries = (MosaicEntry*)g_array_free(entries, FALSE);
+}
+
+
+/*********
+ * Tiles *
+ *********/
+static void _tile_upload(GritsTile *tile, guint8 *pixels)
+{
+	if (!tile->tex) {
+		glGenTextures(1, &tile->tex);
+		glBindTexture(GL_TEXTURE_2D, tile->tex);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, 4, MOSAIC_TILE, MOSAIC_TILE, 0,
+				GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	} else {
+		glBindTexture(GL_TEXTURE_2D, tile->tex);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, MOSAIC_TILE, MOSAIC_TILE,
+				GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	}
+	tile->coords.n = 0;
+	tile->coords.w = 0;
+	tile->coords.s = 1;
+	tile->coords.e = 1;
+	glFlush();
+}
+
+static GritsTile *_tile_new(AWeatherMosaic *mosaic, gint ti)
+{
+	gdouble north = MOSAIC_NORTH - (ti / MOSAIC_COLS) * MOSAIC_TILE*MOSAIC_DEG;
+	gdouble west  = MOSAIC_WEST  + (ti % MOSAIC_COLS) * MOSAIC_TILE*MOSAIC_DEG;
+	GritsTile *tile = grits_tile_new(NULL, north, north - MOSAIC_TILE*MOSAIC_DEG,
+			west + MOSAIC_TILE*MOSAIC_DEG, west);
+	tile->zindex = 3;
+	grits_object_hide(GRITS_OBJECT(tile), mosaic->hidden);
+	grits_viewer_add(mosaic->viewer, GRITS_OBJECT(tile), GRITS_LEVEL_WORLD+2, FALSE);
+	return tile;
+}
+
+/* Combine every site covering a tile and upload it */
+static void _tile_compose(AWeatherMosaic *mosaic, gint ti)
+{
+	guint8  *value = g_malloc0(MOSAIC_TILE*MOSAIC_TILE);
+	guint16 *dist  = g_malloc(MOSAIC_TILE*MOSAIC_TILE*sizeof(guint16));
+	memset(dist, 0xff, MOSAIC_TILE*MOSAIC_TILE*sizeof(guint16));
+	gboolean covered = FALSE;
+
+	GHashTableIter iter;
+	MosaicSite    *site;
+	g_hash_table_iter_init(&iter, mosaic->sites);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer*)&site)) {
+		for (gint i = site->start[ti]; i < site->start[ti+1]; i++) {
+			MosaicEntry *entry = &site->entries[i];
+			guint8       v     = site->values[i];
+			if (mosaic->mode == MOSAIC_MAX) {
+				value[entry->cell] = MAX(value[entry->cell], v);
+			} else if (entry->dist < dist[entry->cell]) {
+				dist[entry->cell]  = entry->dist;
+				value[entry->cell] = v;
+			}
+			covered = TRUE;
+		}
+	}
+
+	if (!covered) {
+		grits_object_destroy_pointer(&mosaic->tiles[ti]);
+	} else {
+		guint8 *pixels = g_malloc0(MOSAIC_TILE*MOSAIC_TILE*4);
+		for (gint i = 0; i < MOSAIC_TILE*MOSAIC_TILE; i++) {
+			if (value[i] == 0)
+				continue;
+			guint8 *color = colormap_get(mosaic->colormap, value[i]-64);
+			pixels[i*4+0] = color[0];
+			pixels[i*4+1] = color[1];
+			pixels[i*4+2] = color[2];
+			pixels[i*4+3] = color[3]*0.75;
+		}
+		if (!mosaic->tiles[ti])
+			mosaic->tiles[ti] = _tile_new(mosaic, ti);
+		_tile_upload(mosaic->tiles[ti], pixels);
+		g_free(pixels);
+	}
+	g_free(value);
+	g_free(dist);
+}
+
+static void _mark(MosaicSite *site, gboolean dirty[MOSAIC_TILES])
+{
+	for (gint ti = 0; ti < MOSAIC_TILES; ti++)
+		if (site->start[ti] < site->start[ti+1])
+			dirty[ti] = TRUE;
+}
+
+static void _compose(AWeatherMosaic *mosaic, gboolean dirty[MOSAIC_TILES])
+{
+	for (gint ti = 0; ti < MOSAIC_TILES; ti++)
+		if (dirty[ti])
+			_tile_compose(mosaic, ti);
+	grits_viewer_queue_draw(mosaic->viewer);
+}
+
+
+/***********
+ * Methods *
+ ***********/
+AWeatherMosaic *aweather_mosaic_new(GritsViewer *viewer, AWeatherColormap *colormap)
+{
+	g_debug("AWeatherMosaic: new");
+	AWeatherMosaic *mosaic = g_new0(AWeatherMosaic, 1);
+	mosaic->viewer   = g_object_ref(viewer);
+	mosaic->colormap = colormap;
+	mosaic->hidden   = TRUE;
+	mosaic->sites    = g_hash_table_new_full(g_str_hash, g_str_equal,
+			NULL, (GDestroyNotify)_site_free);
+	return mosaic;
+}
+
+/* Replace a site's lowest sweep. The gate values are scattered through the
+ * site's table and only the tiles the site covers are redrawn. */
+void aweather_mosaic_update(AWeatherMosaic *mosaic, const gchar *code,
+		gdouble lat, gdouble lon, AWeatherSweep *sweep)
+{
+	g_debug("AWeatherMosaic: update - %s", code);
+	gboolean    dirty[MOSAIC_TILES] = {};
+	MosaicSite *site = g_hash_table_lookup(mosaic->sites, code);
+	if (!site) {
+		site       = g_new0(MosaicSite, 1);
+		site->code = g_strdup(code);
+		site->lat  = lat;
+		site->lon  = lon;
+		g_hash_table_insert(mosaic->sites, site->code, site);
+	}
+	if (!_site_matches(site, sweep)) {
+		_mark(site, dirty);
+		_site_table(site, sweep);
+	}
+	_mark(site, dirty);
+
+	for (gint i = 0; i < site->start[MOSAIC_TILES]; i++) {
+		guint32 gate = site->entries[i].gate;
+		guint   raw  = aweather_sweep_code(sweep,
+				gate / sweep->nbins, gate % sweep->nbins);
+		site->values[i] = raw < CODE_MIN ? 0 :
+			CLAMP(aweather_sweep_value(sweep, raw) + 64.5, 1, 255);
+	}
+	_compose(mosaic, dirty);
+}
+
+void aweather_mosaic_remove(AWeatherMosaic *mosaic, const gchar *code)
+{
+	MosaicSite *site = g_hash_table_lookup(mosaic->sites, code);
+	if (!site)
+		return;
+	g_debug("AWeatherMosaic: remove - %s", code);
+	gboolean dirty[MOSAIC_TILES] = {};
+	_mark(site, dirty);
+	g_hash_table_remove(mosaic->sites, code);
+	_compose(mosaic, dirty);
+}
+
+void aweather_mosaic_set_mode(AWeatherMosaic *mosaic, AWeatherMosaicMode mode)
+{
+	g_debug("AWeatherMosaic: set_mode - %d", mode);
+	gboolean dirty[MOSAIC_TILES] = {};
+	mosaic->mode = mode;
+	for (gint ti = 0; ti < MOSAIC_TILES; ti++)
+		dirty[ti] = mosaic->tiles[ti] != NULL;
+	_compose(mosaic, dirty);
+}
+
+void aweather_mosaic_hide(AWeatherMosaic *mosaic, gboolean hidden)
+{
+	mosaic->hidden = hidden;
+	for (gint ti = 0; ti < MOSAIC_TILES; ti++)
+		if (mosaic->tiles[ti])
+			grits_object_hide(GRITS_OBJECT(mosaic->tiles[ti]), hidden);
+}
+
+void aweather_mosaic_free(AWeatherMosaic *mosaic)
+{
+	g_debug("AWeatherMosaic: free");
+	for (gint ti = 0; ti < MOSAIC_TILES; ti++)
+		grits_object_destroy_pointer(&mosaic->tiles[ti]);
+	g_hash_table_destroy(mosaic->sites);
+	g_object_unref(mosaic->viewer);
+	g_free(mosaic);
+}
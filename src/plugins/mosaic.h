@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2009-2012 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __AWEATHER_MOSAIC_H__
+#define __AWEATHER_MOSAIC_H__
+
+#include <grits.h>
+#include "store.h"
+
+/* Lat/lon grid shared by all sites, split into square tiles */
+#define MOSAIC_NORTH   55.0
+#define MOSAIC_WEST   -130.0
+#define MOSAIC_DEG     0.02  // Degrees per cell
+#define MOSAIC_TILE    256   // Cells across each tile
+#define MOSAIC_COLS    14    // Tiles from west to east
+#define MOSAIC_ROWS    7     // Tiles from north to south
+#define MOSAIC_TILES   (MOSAIC_COLS*MOSAIC_ROWS)
+
+typedef enum {
+	MOSAIC_NEAREST, // Use the closest radar covering each cell
+	MOSAIC_MAX,     // Use the strongest echo from any radar
+} AWeatherMosaicMode;
+
+/* Gate that fills a cell, sorted by tile */
+typedef struct {
+	guint16 cell;   // Cell within the tile
+	guint16 dist;   // Distance from the radar, 100 m
+	guint32 gate;   // Ray*nbins+bin in the sweep
+} MosaicEntry;
+
+typedef struct {
+	gchar        *code;
+	gdouble       lat, lon;
+	gint          nrays, nbins;   // Geometry the table was built for
+	gfloat        range_bin1, gate_size, elev;
+	MosaicEntry  *entries;
+	gint          start[MOSAIC_TILES+1];
+	guint8       *values;         // dBZ+64 at each entry, 0 for no echo
+} MosaicSite;
+
+typedef struct {
+	GritsViewer        *viewer;
+	AWeatherColormap   *colormap;
+	AWeatherMosaicMode  mode;
+	gboolean            hidden;
+	GHashTable         *sites;    // Site code -> MosaicSite
+	GritsTile          *tiles[MOSAIC_TILES]; // NULL when nothing covers them
+} AWeatherMosaic;
+
+AWeatherMosaic *aweather_mosaic_new(GritsViewer *viewer, AWeatherColormap *colormap);
+
+void aweather_mosaic_update(AWeatherMosaic *mosaic, const gchar *code,
+		gdouble lat, gdouble lon, AWeatherSweep *sweep);
+
+void aweather_mosaic_remove(AWeatherMosaic *mosaic, const gchar *code);
+
+void aweather_mosaic_set_mode(AWeatherMosaic *mosaic, AWeatherMosaicMode mode);
+
+void aweather_mosaic_hide(AWeatherMosaic *mosaic, gboolean hidden);
+
+void aweather_mosaic_free(AWeatherMosaic *mosaic);
+
+#endif
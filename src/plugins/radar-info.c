@@ -15,16 +15,159 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <rsl.h>
 #include "radar-info.h"
 
 AWeatherColormap colormaps[] = {
-	// type    file      ...
-	{DZ_INDEX, "dz.clr"},
-	{VR_INDEX, "vr.clr"},
-	{SW_INDEX, "sw.clr"},
-	{DR_INDEX, "dr.clr"},
-	{PH_INDEX, "ph.clr"},
-	{RH_INDEX, "rh.clr"},
-	{0,        NULL    },
+	// type       file      units  ...
+	{DZ_INDEX,    "dz.clr", "dBZ"},
+	{VR_INDEX,    "vr.clr", "m/s"},
+	{SW_INDEX,    "sw.clr", "m/s"},
+	{DR_INDEX,    "dr.clr", "dB" },
+	{PH_INDEX,    "ph.clr", "°"  },
+	{RH_INDEX,    "rh.clr", ""   },
+	{SRV_INDEX,   "vr.clr", "m/s"},
+	{RN1_INDEX,   "rn.clr", "mm" },
+	{RN3_INDEX,   "rn.clr", "mm" },
+	{RNT_INDEX,   "rn.clr", "mm" },
+	{CAPPI_INDEX, "dz.clr", "dBZ"},
+	{0,           NULL,     NULL },
 };
+
+RadarAzIndex *radar_azindex_new(const gfloat *azimuth, gint nrays, gfloat beam_width)
+{
+	RadarAzIndex *index = g_new(RadarAzIndex, 1);
+	gfloat       *error = g_new(gfloat, RADAR_AZ_BUCKETS);
+	for (gint i = 0; i < RADAR_AZ_BUCKETS; i++) {
+		index->ray[i] = -1;
+		error[i]      = G_MAXFLOAT;
+	}
+
+	/* Each ray claims the buckets within half a beam width, when rays
+	 * overlap or are duplicated the closest one wins */
+	const gdouble size  = 360.0/RADAR_AZ_BUCKETS;
+	const gint    reach = ceil(beam_width/2/size);
+	for (gint ri = 0; ri < nrays; ri++) {
+		gint mid = floor(azimuth[ri]/size);
+		for (gint d = -reach; d <= reach; d++) {
+			gint    i   = ((mid + d) % RADAR_AZ_BUCKETS + RADAR_AZ_BUCKETS)
+			            % RADAR_AZ_BUCKETS;
+			gdouble err = fabs((mid + d + 0.5)*size - azimuth[ri]);
+			if (err < error[i]) {
+				index->ray[i] = ri;
+				error[i]      = err;
+			}
+		}
+	}
+	g_free(error);
+	return index;
+}
+
+void radar_azindex_free(RadarAzIndex *index)
+{
+	g_free(index);
+}
+
+static gint _times_cmp(const RadarTime *a, const RadarTime *b)
+{
+	return a->time < b->time ? -1 :
+	       a->time > b->time ?  1 : strcmp(a->name, b->name);
+}
+
+/* Parse the time from each name, offset is the position of the time
+ * (YYYYMMDD_HHMM) within the names. Names without a time are skipped, and
+ * names listed more than once are only kept once. */
+RadarTimeIndex *radar_times_new(GList *files, gsize offset)
+{
+	RadarTimeIndex *index = g_new0(RadarTimeIndex, 1);
+	index->files = g_new0(RadarTime, g_list_length(files));
+	for (GList *cur = files; cur; cur = cur->next) {
+		gchar    *name = cur->data;
+		struct tm tm   = {};
+		if (strlen(name) <= offset || sscanf(name+offset, "%4d%2d%2d_%2d%2d",
+				&tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+				&tm.tm_hour, &tm.tm_min) != 5)
+			continue;
+		tm.tm_year -= 1900;
+		tm.tm_mon  -= 1;
+		tm.tm_isdst = -1;
+		index->files[index->nfiles].name = g_strdup(name);
+		index->files[index->nfiles].time = mktime(&tm);
+		index->nfiles++;
+	}
+	qsort(index->files, index->nfiles, sizeof(RadarTime),
+			(GCompareFunc)_times_cmp);
+	gint n = 0;
+	for (gint i = 0; i < index->nfiles; i++) {
+		if (n > 0 && _times_cmp(&index->files[n-1], &index->files[i]) == 0)
+			g_free(index->files[i].name);
+		else
+			index->files[n++] = index->files[i];
+	}
+	index->nfiles = n;
+	return index;
+}
+
+/* Merge more names into the index, names it already has are skipped */
+void radar_times_add(RadarTimeIndex *index, GList *files, gsize offset)
+{
+	RadarTimeIndex *add    = radar_times_new(files, offset);
+	RadarTime      *merged = g_new(RadarTime, index->nfiles + add->nfiles);
+	gint i = 0, j = 0, n = 0;
+	while (i < index->nfiles || j < add->nfiles) {
+		gint cmp = i >= index->nfiles ?  1 :
+		           j >= add->nfiles   ? -1 :
+		           _times_cmp(&index->files[i], &add->files[j]);
+		if (cmp == 0)
+			g_free(add->files[j++].name);
+		merged[n++] = cmp <= 0 ? index->files[i++] : add->files[j++];
+	}
+	g_free(index->files);
+	g_free(add->files);
+	g_free(add);
+	index->files  = merged;
+	index->nfiles = n;
+}
+
+/* Index of the file closest to time, earlier files win ties, -1 if empty */
+gint radar_times_nearest(RadarTimeIndex *index, time_t time)
+{
+	if (index->nfiles == 0)
+		return -1;
+	gint lo = 0, hi = index->nfiles; // First file at or after time
+	while (lo < hi) {
+		gint mid = (lo + hi) / 2;
+		if (index->files[mid].time < time)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == index->nfiles)
+		return lo - 1;
+	if (lo > 0 && time - index->files[lo-1].time <= index->files[lo].time - time)
+		return lo - 1;
+	return lo;
+}
+
+/* Names of up to before files before i, i, and up to after files after it,
+ * oldest first */
+GList *radar_times_window(RadarTimeIndex *index, gint i, gint before, gint after)
+{
+	GList *names = NULL;
+	if (i < 0 || i >= index->nfiles)
+		return NULL;
+	for (gint j = MIN(i+after, index->nfiles-1); j >= MAX(i-before, 0); j--)
+		names = g_list_prepend(names, g_strdup(index->files[j].name));
+	return names;
+}
+
+void radar_times_free(RadarTimeIndex *index)
+{
+	for (gint i = 0; i < index->nfiles; i++)
+		g_free(index->files[i].name);
+	g_free(index->files);
+	g_free(index);
+}
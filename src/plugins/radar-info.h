@@ -19,11 +19,14 @@
 #define __AWEATHER_COLORMAP_H__
 
 #include <glib.h>
+#include <math.h>
+#include <time.h>
 #include <rsl.h>
 
 typedef struct {
 	gint     type;     // From RSL e.g. DZ_INDEX
 	gchar   *file;     // Basename of the colors file
+	gchar   *units;    // Units of the values, for display
 	gchar    name[64]; // Name of the colormap          (line 1)
 	gfloat   scale;    // Map values to color table idx (line 2)
 	gfloat   shift;    //   index = value*scale + shift (line 3)
@@ -31,8 +34,73 @@ typedef struct {
 	guint8 (*data)[4]; // The actual colormap           (line 4..)
 } AWeatherColormap;
 
+/* Derived products, numbered after the RSL volumes */
+#define SRV_INDEX   (MAX_RADAR_VOLUMES+0) // Storm relative velocity
+#define RN1_INDEX   (MAX_RADAR_VOLUMES+1) // 1 hour precipitation
+#define RN3_INDEX   (MAX_RADAR_VOLUMES+2) // 3 hour precipitation
+#define RNT_INDEX   (MAX_RADAR_VOLUMES+3) // Storm total precipitation
+#define CAPPI_INDEX (MAX_RADAR_VOLUMES+4) // Constant altitude reflectivity
+
+/* RSL reserves the lowest gate codes for flags (BADVAL, RFVAL, etc) */
+#define CODE_MIN    4
+#define CODE_NOECHO 3 // Flag for gates that were scanned but had no echo
+
 extern AWeatherColormap colormaps[];
 
+/* Azimuth index, maps fixed azimuth buckets to the ray covering them so
+ * rays can be found without searching. Buckets that are not within half a
+ * beam width of any ray, such as for missing rays, map to -1. */
+#define RADAR_AZ_BUCKETS 3600   // Tenth of a degree buckets
+
+typedef struct {
+	gint16 ray[RADAR_AZ_BUCKETS];
+} RadarAzIndex;
+
+RadarAzIndex *radar_azindex_new(const gfloat *azimuth, gint nrays, gfloat beam_width);
+
+void radar_azindex_free(RadarAzIndex *index);
+
+/* Time index, the files of a directory listing sorted by the time in their
+ * names so they can be searched without parsing every name again */
+typedef struct {
+	gchar  *name;
+	time_t  time;
+} RadarTime;
+
+typedef struct {
+	RadarTime *files; // Oldest first
+	gint       nfiles;
+} RadarTimeIndex;
+
+RadarTimeIndex *radar_times_new(GList *files, gsize offset);
+
+void radar_times_add(RadarTimeIndex *index, GList *files, gsize offset);
+
+gint radar_times_nearest(RadarTimeIndex *index, time_t time);
+
+GList *radar_times_window(RadarTimeIndex *index, gint i, gint before, gint after);
+
+void radar_times_free(RadarTimeIndex *index);
+
+static inline gint radar_azindex_get(RadarAzIndex *index, gdouble azimuth)
+{
+	gint i = floor(azimuth * (RADAR_AZ_BUCKETS/360.0));
+	i %= RADAR_AZ_BUCKETS;
+	return index->ray[i < 0 ? i + RADAR_AZ_BUCKETS : i];
+}
+
+/* Height of a beam and the slant range needed to reach a ground distance,
+ * assuming standard refraction (4/3 earth radius) */
+static inline void beam_height(gdouble dist, gdouble elev,
+		gdouble *height, gdouble *range)
+{
+	const gdouble radius = 6371000.0 * 4/3;
+	gdouble theta = dist / radius;
+	gdouble angle = elev * G_PI / 180;
+	*height = radius * (cos(angle) / cos(angle+theta) - 1);
+	*range  = radius *  sin(theta) / cos(angle+theta);
+}
+
 static inline guint8 *colormap_get(AWeatherColormap *colormap, float value)
 {
 	int idx = value * colormap->scale + colormap->shift;
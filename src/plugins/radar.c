@@ -17,6 +17,7 @@
 
 #define _XOPEN_SOURCE
 #include <time.h>
+#include <string.h>
 #include <config.h>
 #include <glib/gstdio.h>
 #include <gtk/gtk.h>
@@ -28,6 +29,8 @@
 
 #include "radar.h"
 #include "level2.h"
+#include "anim.h"
+#include "gif.h"
 #include "../aweather-location.h"
 
 #include "../compat.h"
@@ -41,33 +44,106 @@ static void aweather_bin_set_child(GtkBin *bin, GtkWidget *new)
 	gtk_widget_show_all(new);
 }
 
-static gchar *_find_nearest(time_t time, GList *files,
-		gsize offset)
-{
-	g_debug("RadarSite: find_nearest ...");
-	time_t  nearest_time = 0;
-	char   *nearest_file = NULL;
-
-	struct tm tm = {};
-	for (GList *cur = files; cur; cur = cur->next) {
-		gchar *file = cur->data;
-		sscanf(file+offset, "%4d%2d%2d_%2d%2d",
-				&tm.tm_year, &tm.tm_mon, &tm.tm_mday,
-				&tm.tm_hour, &tm.tm_min);
-		tm.tm_year -= 1900;
-		tm.tm_mon  -= 1;
-		if (ABS(time - mktime(&tm)) <
-		    ABS(time - nearest_time)) {
-			nearest_file = file;
-			nearest_time = mktime(&tm);
-		}
+/*************
+ * RadarHttp *
+ *************/
+/* Sessions shared by all sites. Each session is leased to one fetch at a
+ * time, so connections to the server are kept alive and reused between
+ * sites, the number of sessions caps the connections to the server, and a
+ * site's fetch can still be aborted without affecting the others. */
+#define RADAR_HTTP_MAX 16
+
+struct _RadarHttp {
+	GMutex      lock;
+	GCond       cond;
+	GritsHttp  *all[RADAR_HTTP_MAX];
+	GritsHttp  *idle[RADAR_HTTP_MAX];
+	gint        nall;
+	gint        nidle;
+};
+
+RadarHttp *radar_http_new(gint sessions)
+{
+	RadarHttp *http = g_new0(RadarHttp, 1);
+	g_mutex_init(&http->lock);
+	g_cond_init(&http->cond);
+	http->nall = CLAMP(sessions, 1, RADAR_HTTP_MAX);
+	for (gint i = 0; i < http->nall; i++)
+		http->all[i] = http->idle[http->nidle++] =
+			grits_http_new(G_DIR_SEPARATOR_S
+				"nexrad" G_DIR_SEPARATOR_S
+				"level2" G_DIR_SEPARATOR_S);
+	return http;
+}
+
+/* A site's claim on one of the sessions, the lock protects both fields */
+typedef enum {
+	RADAR_LEASE_IDLE,      // No session, and nothing pending
+	RADAR_LEASE_WAITING,   // Waiting in radar_http_lease for a session
+	RADAR_LEASE_HELD,      // Holding session until it's released
+	RADAR_LEASE_CANCELLED, // Aborted, the next lease returns NULL
+} RadarLeaseState;
+
+typedef struct {
+	GritsHttp      *session;
+	RadarLeaseState state;
+} RadarLease;
+
+/* Wait for an idle session and hold it in lease until it's released. NULL
+ * is returned if the lease is aborted while waiting, or was aborted since
+ * it was last released, the caller decides whether to try again. */
+GritsHttp *radar_http_lease(RadarHttp *http, RadarLease *lease)
+{
+	g_mutex_lock(&http->lock);
+	if (lease->state != RADAR_LEASE_CANCELLED)
+		lease->state = RADAR_LEASE_WAITING;
+	while (http->nidle == 0 && lease->state == RADAR_LEASE_WAITING)
+		g_cond_wait(&http->cond, &http->lock);
+	if (lease->state == RADAR_LEASE_CANCELLED) {
+		lease->state   = RADAR_LEASE_IDLE;
+		lease->session = NULL;
+	} else {
+		lease->state   = RADAR_LEASE_HELD;
+		lease->session = http->idle[--http->nidle];
 	}
+	GritsHttp *session = lease->session;
+	g_mutex_unlock(&http->lock);
+	return session;
+}
 
-	g_debug("RadarSite: find_nearest = %s", nearest_file);
-	if (nearest_file)
-		return g_strdup(nearest_file);
-	else
-		return NULL;
+void radar_http_release(RadarHttp *http, RadarLease *lease)
+{
+	g_mutex_lock(&http->lock);
+	if (lease->state == RADAR_LEASE_HELD) {
+		http->idle[http->nidle++] = lease->session;
+		g_cond_broadcast(&http->cond);
+	}
+	lease->state   = RADAR_LEASE_IDLE;
+	lease->session = NULL;
+	g_mutex_unlock(&http->lock);
+}
+
+/* Abort the fetch using the session held by lease. If the lease is waiting
+ * for a session, or has none yet, its next lease is cancelled instead. */
+void radar_http_abort(RadarHttp *http, RadarLease *lease)
+{
+	g_mutex_lock(&http->lock);
+	if (lease->state == RADAR_LEASE_HELD) {
+		grits_http_abort(lease->session);
+	} else {
+		lease->state = RADAR_LEASE_CANCELLED;
+		g_cond_broadcast(&http->cond);
+	}
+	g_mutex_unlock(&http->lock);
+}
+
+void radar_http_free(RadarHttp *http)
+{
+	for (gint i = 0; i < http->nall; i++)
+		grits_http_free(http->all[i]);
+	g_mutex_clear(&http->lock);
+	g_cond_clear(&http->cond);
+	g_free(http);
 }
 
 
@@ -86,25 +162,161 @@ struct _RadarSite {
 
 	/* Stuff from the parents */
 	GritsViewer    *viewer;
-	GritsHttp      *http;
+	RadarHttp      *http;        // Sessions shared by all sites
 	GritsPrefs     *prefs;
 	GtkWidget      *pconfig;
+	AWeatherMosaic *mosaic;      // Shared by all sites
+	GThreadPool    *pool;        // Shared by all sites, runs updates
 
 	/* When loaded */
 	gboolean        hidden;
 	RadarSiteStatus status;      // Loading status for the site
 	GtkWidget      *config;
 	AWeatherLevel2 *level2;      // The Level2 structure for the current volume
+	AWeatherLevel2 *quick;       // Quick look shown while level2 is loading
+	AWeatherAnim   *anim;        // Loop through recent volumes, while playing
+	AWeatherMotion  motion;      // Storm motion, tracked across volumes
+	AWeatherRain   *rain;        // Rainfall accumulated across volumes
 
 	/* Internal data */
 	time_t          time;        // Current timestamp of the level2
 	gchar          *message;     // Error message set while updating
 	guint           time_id;     // "time-changed"     callback ID
 	guint           refresh_id;  // "refresh"          callback ID
-	guint           location_id; // "locaiton-changed" callback ID
+	gdouble         xyz[3];      // Position of the radar
+	guint           stamp;       // Last location update it was in range for
+	time_t          prefetch;    // Time of the volume queued for prefetching
 	guint           idle_source; // _site_update_end idle source
+	gint            serial;      // Incremented for each update or cancel
+	gint            loading;     // Serial of the update being loaded
+	gboolean        unload;      // Unload once the cancelled update ends
+	AWeatherQuick  *partial;     // Quick look of the file being downloaded
+	goffset         quick_next;  // Download size to try the quick look at
+	GList          *names;       // Volumes up to the current one, oldest first
+	GList          *next_names;  // Names found by the update, swapped in at the end
+	RadarTimeIndex *times;       // Volumes in the directory listing
+	gsize           list_read;   // Bytes of the cached listing in times
+	time_t          list_time;   // When the whole listing was last fetched
+	RadarLease      update_http; // Session leased by the update in progress
+	RadarLease      anim_http;   // Session leased by the animation's thread
+	gint            anim_stop;   // The animation is being destroyed
+	RadarLease      prefetch_http; // Session leased by a prefetch of the site
+	gboolean        prefetching; // Downloading in the prefetcher, prefetch_lock
+	gboolean        current;     // Showing the newest volume in the listing
+	gboolean        polling;     // The update in progress polls the feed
+	guint           poll_id;     // _site_poll timeout source
+	AWeatherLevel2 *live;        // Volume with new tilts found by a poll
+	AWeatherIngest *ingest;      // Volume being read from the real-time feed
+	gchar          *ingest_name; // Date and time prefix of its chunks
+	gint            ingest_seq;  // Last chunk added to it
 };
 
+/* Bytes to download between attempts at decoding a quick look */
+#define QUICK_STEP (256*1024)
+
+/* Volumes that were already cached when a site loaded them */
+static gint cache_loads, cache_hits;
+
+/* Sites being prefetched, an update of the same site waits for the
+ * prefetch since both download to the same files */
+static GMutex prefetch_lock;
+static GCond  prefetch_cond;
+
+/* Fetch and load a volume for the animation, this runs in the
+ * animation's thread so it leases a separate http session */
+static AWeatherStore *_site_anim_load(const gchar *name, gpointer _site)
+{
+	RadarSite *site = _site;
+	GritsHttp *http = NULL;
+	while (!g_atomic_int_get(&site->anim_stop) &&
+	       !(http = radar_http_lease(site->http, &site->anim_http)));
+	if (!http)
+		return NULL;
+	gboolean offline = grits_viewer_get_offline(site->viewer);
+	gchar *nexrad_url = grits_prefs_get_string(site->prefs,
+			"aweather/nexrad_url", NULL);
+	gchar *local = g_strconcat(site->city->code, "/", name, NULL);
+	gchar *uri   = g_strconcat(nexrad_url, "/", local, NULL);
+	gchar *file  = grits_http_fetch(http, uri, local,
+			offline ? GRITS_LOCAL : GRITS_ONCE, NULL, NULL);
+	radar_http_release(site->http, &site->anim_http);
+	AWeatherStore *store = file && !g_atomic_int_get(&site->anim_stop) ?
+		aweather_level2_load(file, site->city->code) : NULL;
+	g_free(nexrad_url);
+	g_free(local);
+	g_free(uri);
+	g_free(file);
+	return store;
+}
+
+/* The animation's thread is joined when it's destroyed, so any download it
+ * is waiting on is aborted first */
+static void _site_anim_stop(RadarSite *site)
+{
+	if (!site->anim)
+		return;
+	g_debug("RadarSite: anim_stop - %s", site->city->code);
+	g_atomic_int_set(&site->anim_stop, TRUE);
+	radar_http_abort(site->http, &site->anim_http);
+	grits_object_destroy_pointer(&site->anim);
+	if (site->level2)
+		grits_object_hide(GRITS_OBJECT(site->level2), site->hidden);
+}
+
+static void _site_anim_start(RadarSite *site)
+{
+	if (site->anim || !site->level2)
+		return;
+	g_debug("RadarSite: anim_start - %s", site->city->code);
+	g_atomic_int_set(&site->anim_stop, FALSE);
+	gint    frames = grits_prefs_get_integer(site->prefs, "aweather/anim_frames", NULL);
+	gint    budget = grits_prefs_get_integer(site->prefs, "aweather/anim_budget", NULL);
+	gdouble fps    = grits_prefs_get_double (site->prefs, "aweather/anim_fps",    NULL);
+	gint    steps  = grits_prefs_get_integer(site->prefs, "aweather/anim_steps",  NULL);
+	gchar  *tween  = grits_prefs_get_string (site->prefs, "aweather/anim_tween",  NULL);
+
+	AWeatherColormap *colormap = &colormaps[0];
+	for (int i = 0; colormaps[i].file; i++)
+		if (colormaps[i].type == DZ_INDEX)
+			colormap = &colormaps[i];
+
+	site->anim = aweather_anim_new(_site_anim_load, site, colormap,
+			frames > 0 ? frames : 10,
+			(gsize)(budget > 0 ? budget : 256) << 20);
+	GRITS_OBJECT(site->anim)->center = GRITS_OBJECT(site->level2)->center;
+	aweather_anim_set_tween(site->anim, aweather_tween_mode(tween), steps);
+	aweather_anim_set_names(site->anim, site->names);
+	aweather_anim_play(site->anim, fps > 0 ? fps : 4);
+	grits_object_hide(GRITS_OBJECT(site->anim), site->hidden);
+	grits_object_hide(GRITS_OBJECT(site->level2), TRUE);
+	grits_viewer_add(site->viewer, GRITS_OBJECT(site->anim),
+			GRITS_LEVEL_WORLD+3, TRUE);
+	g_free(tween);
+}
+
+static void _site_anim_toggled(GtkToggleButton *button, gpointer _site)
+{
+	RadarSite *site = _site;
+	if (gtk_toggle_button_get_active(button))
+		_site_anim_start(site);
+	else
+		_site_anim_stop(site);
+}
+
+static GtkWidget *_site_anim_config(RadarSite *site)
+{
+	GtkWidget *box    = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
+	GtkWidget *label  = gtk_label_new("<b>Loop:</b>");
+	GtkWidget *button = gtk_toggle_button_new_with_label("Play");
+	gtk_label_set_use_markup(GTK_LABEL(label), TRUE);
+	gtk_widget_set_size_request(button, 50, 26);
+	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(button), site->anim != NULL);
+	g_signal_connect(button, "toggled", G_CALLBACK(_site_anim_toggled), site);
+	gtk_box_pack_start(GTK_BOX(box), label,  FALSE, FALSE, 5);
+	gtk_box_pack_start(GTK_BOX(box), button, FALSE, FALSE, 0);
+	return box;
+}
+
 /* format: http://mesonet.agron.iastate.edu/data/nexrd2/raw/KABR/KABR_20090510_0323 */
 void _site_update_loading(gchar *file, goffset cur,
 		goffset total, gpointer _site)
@@ -117,10 +329,90 @@ void _site_update_loading(gchar *file, goffset cur,
 			percent*100, (double)cur/1000000, (double)total/1000000);
 	gtk_progress_bar_set_text(GTK_PROGRESS_BAR(progress_bar), msg);
 	g_free(msg);
+
+	/* Show the lowest cut as soon as it has been downloaded */
+	if (site->partial && !site->quick && cur >= site->quick_next) {
+		site->quick_next = cur + QUICK_STEP;
+		AWeatherStore *store = aweather_quick_update(site->partial);
+		if (store) {
+			g_debug("RadarSite: update_loading - quick look");
+			site->quick = aweather_level2_new_from_store(store, colormaps);
+			grits_object_hide(GRITS_OBJECT(site->quick),
+					site->hidden || site->anim != NULL);
+			grits_viewer_add(site->viewer, GRITS_OBJECT(site->quick),
+					GRITS_LEVEL_WORLD+3, TRUE);
+		}
+	}
+}
+void radar_site_unload(RadarSite *site);
+
+/* Queue an update, the serial is recorded now so a cancel that comes in
+ * before the update starts is still seen by it */
+static void _site_update_push(RadarSite *site)
+{
+	site->loading = g_atomic_int_get(&site->serial);
+	g_thread_pool_push(site->pool, site, NULL);
+}
+
+/* Updates that were superseded while loading are run again with the
+ * newest time, or the site is unloaded if that was requested instead */
+static gboolean _site_update_restart(RadarSite *site)
+{
+	if (site->loading == g_atomic_int_get(&site->serial))
+		return FALSE;
+	g_debug("RadarSite: update_restart - %s", site->city->code);
+	g_list_free_full(site->next_names, g_free);
+	site->next_names = NULL;
+	grits_object_destroy_pointer(&site->level2);
+	grits_object_destroy_pointer(&site->quick);
+	grits_object_destroy_pointer(&site->live);
+	site->idle_source = 0;
+	site->polling     = FALSE;
+	if (site->unload) {
+		site->unload = FALSE;
+		site->status = STATUS_LOADED;
+		radar_site_unload(site);
+	} else {
+		GtkWidget *progress = gtk_progress_bar_new();
+		gtk_progress_bar_set_text(GTK_PROGRESS_BAR(progress), "Loading...");
+		aweather_bin_set_child(GTK_BIN(site->config), progress);
+		_site_update_push(site);
+	}
+	return TRUE;
 }
+
 gboolean _site_update_end(gpointer _site)
 {
 	RadarSite *site = _site;
+	if (_site_update_restart(site))
+		return FALSE;
+
+	/* The main thread reads the names, so they're only replaced here */
+	g_list_free_full(site->names, g_free);
+	site->names      = site->next_names;
+	site->next_names = NULL;
+
+	/* Polls only replace the volume when new tilts arrived */
+	if (site->polling) {
+		site->polling = FALSE;
+		if (!site->live) {
+			if (site->message)
+				g_debug("RadarSite: update_end - poll - %s", site->message);
+			site->message     = NULL;
+			site->status      = STATUS_LOADED;
+			site->idle_source = 0;
+			return FALSE;
+		}
+		if (site->level2)
+			aweather_level2_set_sweep(site->live,
+					site->level2->sweep_type, site->level2->sweep_elev);
+		grits_object_destroy_pointer(&site->level2);
+		site->level2 = site->live;
+		site->live   = NULL;
+		grits_object_hide(GRITS_OBJECT(site->level2),
+				site->hidden || site->anim != NULL);
+	}
+
 	if (site->message) {
 		g_warning("RadarSite: update_end - %s", site->message);
 		const char *fmt = "http://forecast.weather.gov/product.php?site=NWS&product=FTM&format=TXT&issuedby=%s";
@@ -134,46 +426,356 @@ gboolean _site_update_end(gpointer _site)
 		aweather_bin_set_child(GTK_BIN(site->config), box);
 		g_free(uri);
 	} else {
-		aweather_bin_set_child(GTK_BIN(site->config),
-				aweather_level2_get_config(site->level2));
+		GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+		gtk_box_pack_start(GTK_BOX(box),
+				aweather_level2_get_config(site->level2), FALSE, FALSE, 0);
+		gtk_box_pack_start(GTK_BOX(box),
+				_site_anim_config(site), FALSE, FALSE, 0);
+		aweather_bin_set_child(GTK_BIN(site->config), box);
+		if (site->anim)
+			aweather_anim_set_names(site->anim, site->names);
+
+		/* Add the lowest tilt to the mosaic */
+		AWeatherVolume *volume = aweather_store_volume(site->level2->store, DZ_INDEX);
+		AWeatherSweep  *lowest = volume ? aweather_volume_closest(volume, 0) : NULL;
+		if (lowest)
+			aweather_mosaic_update(site->mosaic, site->city->code,
+					site->city->pos.lat, site->city->pos.lon, lowest);
 	}
+	grits_object_destroy_pointer(&site->quick);
 	site->status = STATUS_LOADED;
 	site->idle_source = 0;
 	return FALSE;
 }
-gpointer _site_update_thread(gpointer _site)
+/* Refresh the site's directory listing. Listings only grow, so the cached
+ * dir.list is resumed from where it ended and only the new lines are
+ * parsed and merged into the index. The whole listing is fetched again
+ * every LIST_REFRESH seconds in case old volumes were removed. Offline, or
+ * without a listing, the volumes in the cache are used. */
+#define LIST_REFRESH (60*60)
+
+static void _site_list(RadarSite *site, GritsHttp *http,
+		const gchar *nexrad_url, gboolean offline)
+{
+	gboolean full  = !site->times || time(NULL) - site->list_time > LIST_REFRESH;
+	gchar   *local = g_strconcat(site->city->code, "/", "dir.list", NULL);
+	gchar   *uri   = g_strconcat(nexrad_url, "/", local, NULL);
+	gchar   *old   = g_build_filename(g_get_user_cache_dir(), "grits",
+			"nexrad", "level2", site->city->code, "dir.list", NULL);
+	struct stat info;
+	gsize    had   = !full && g_stat(old, &info) == 0 ? info.st_size : 0;
+	gchar   *path  = offline ? NULL : grits_http_fetch(http, uri, local,
+			full ? GRITS_REFRESH : GRITS_UPDATE, NULL, NULL);
+	gchar   *data  = NULL;
+	gsize    size  = 0;
+	if (path && !g_file_get_contents(path, &data, &size, NULL))
+		data = NULL;
+	g_free(local);
+	g_free(uri);
+	g_free(old);
+
+	/* Volumes in the cache */
+	GList *files = NULL;
+	if (full || !data)
+		files = grits_http_available(http, "^\\w{4}_\\d{8}_\\d{4}$",
+				site->city->code, NULL, NULL);
+	if (!data) {
+		if (site->times)
+			radar_times_free(site->times);
+		site->times     = radar_times_new(files, 5);
+		site->list_read = 0;
+		site->list_time = 0;
+		g_list_free_full(files, g_free);
+		g_free(path);
+		return;
+	}
+
+	/* The server sent the whole listing again instead of the new part */
+	gsize start = full ? 0 : MIN(site->list_read, size);
+	gchar *first = memchr(data, '\n', size);
+	gsize  len   = first ? first - data + 1 : 0;
+	if (start > 0 && len && size-start >= len && !memcmp(data, data+start, len)) {
+		g_debug("RadarSite: list - %s, resent", site->city->code);
+		g_file_set_contents(path, data+start, size-start, NULL);
+		memmove(data, data+start, size-start);
+		size -= start;
+		start = 0;
+		full  = TRUE;
+		files = grits_http_available(http, "^\\w{4}_\\d{8}_\\d{4}$",
+				site->city->code, NULL, NULL);
+	}
+
+	/* Parse the new lines, "<size> <name>" */
+	gchar *line = data+start, *end;
+	while ((end = memchr(line, '\n', data+size-line))) {
+		gchar name[32];
+		*end = '\0';
+		if (sscanf(line, "%*d %31s", name) == 1)
+			files = g_list_prepend(files, g_strdup(name));
+		line = end+1;
+	}
+	g_debug("RadarSite: list - %s, %d bytes received, %s",
+			site->city->code, (gint)(size - MIN(had, size)),
+			full ? "full" : "append");
+
+	if (full) {
+		if (site->times)
+			radar_times_free(site->times);
+		site->times     = radar_times_new(files, 5);
+		site->list_time = time(NULL);
+	} else {
+		radar_times_add(site->times, files, 5);
+	}
+	site->list_read = line - data;
+	g_list_free_full(files, g_free);
+	g_free(data);
+	g_free(path);
+}
+
+/* Chunks from the real-time feed are read from <chunk_dir>/<site>/, named
+ * <date>-<time>-<sequence>-<S|I|E> where the date and time are the start
+ * of the volume. Chunks of the newest volume that arrived since the last
+ * call are decoded, and the volume so far is returned when that completed
+ * another tilt. Volumes that are already in the listing are skipped. */
+static gint _chunk_cmp(gconstpointer a, gconstpointer b)
+{
+	return strcmp(*(gchar**)a, *(gchar**)b);
+}
+
+static AWeatherStore *_site_ingest(RadarSite *site, const gchar *chunk_dir,
+		const gchar *nearest)
+{
+	gchar *dir  = g_build_filename(chunk_dir, site->city->code, NULL);
+	GDir  *gdir = g_dir_open(dir, 0, NULL);
+	if (!gdir) {
+		g_free(dir);
+		return NULL;
+	}
+
+	/* Find the chunks of the newest volume */
+	GPtrArray   *chunks = g_ptr_array_new_with_free_func(g_free);
+	gchar        newest[16] = "";
+	const gchar *name;
+	while ((name = g_dir_read_name(gdir))) {
+		if (!g_regex_match_simple("^\\d{8}-\\d{6}-\\d{3}-[SIE]$", name, 0, 0))
+			continue;
+		if (strncmp(name, newest, 15) > 0) {
+			g_strlcpy(newest, name, sizeof(newest));
+			g_ptr_array_set_size(chunks, 0);
+		}
+		if (strncmp(name, newest, 15) == 0)
+			g_ptr_array_add(chunks, g_strdup(name));
+	}
+	g_dir_close(gdir);
+
+	/* Compare YYYYMMDDHHMM with the newest archived volume */
+	gchar feed[13], archive[13];
+	g_snprintf(feed,    sizeof(feed),    "%.8s%.4s", newest,    newest+9);
+	g_snprintf(archive, sizeof(archive), "%.8s%.4s", nearest+5, nearest+14);
+	if (!newest[0] || strlen(nearest) < 18 || strcmp(feed, archive) <= 0) {
+		/* The archived copy has it now, so the live file isn't needed */
+		if (site->ingest) {
+			aweather_ingest_free(site->ingest);
+			g_free(site->ingest_name);
+			site->ingest      = NULL;
+			site->ingest_name = NULL;
+		}
+		g_ptr_array_free(chunks, TRUE);
+		g_free(dir);
+		return NULL;
+	}
+
+	/* Start a new volume */
+	if (!site->ingest || g_strcmp0(site->ingest_name, newest)) {
+		gchar *cache = g_build_filename(g_get_user_cache_dir(), "grits",
+				"nexrad", "level2", site->city->code, NULL);
+		gchar *base  = g_strconcat(site->city->code, "_", newest, ".raw", NULL);
+		gchar *raw   = g_build_filename(cache, base, NULL);
+		g_mkdir_with_parents(cache, 0755);
+		if (site->ingest)
+			aweather_ingest_free(site->ingest);
+		g_free(site->ingest_name);
+		site->ingest      = aweather_ingest_new(raw);
+		site->ingest_name = g_strdup(newest);
+		site->ingest_seq  = 0;
+		g_free(cache);
+		g_free(base);
+		g_free(raw);
+	}
+
+	/* Add new chunks in order, stopping at any that haven't arrived */
+	AWeatherIngest *ingest = site->ingest;
+	gint tilts = ingest->tilts;
+	g_ptr_array_sort(chunks, _chunk_cmp);
+	for (guint i = 0; i < chunks->len; i++) {
+		gchar *chunk = g_ptr_array_index(chunks, i);
+		gint   seq   = atoi(chunk+16);
+		if (seq <= site->ingest_seq)
+			continue;
+		if (seq != site->ingest_seq+1)
+			break;
+		gchar   *path = g_build_filename(dir, chunk, NULL);
+		gboolean ok   = aweather_ingest_chunk(ingest, path);
+		g_free(path);
+		if (!ok) {
+			g_free(site->ingest_name);
+			site->ingest_name = NULL;
+			break;
+		}
+		site->ingest_seq = seq;
+	}
+	g_ptr_array_free(chunks, TRUE);
+	g_free(dir);
+
+	if (ingest->tilts == tilts || !site->ingest_name)
+		return NULL;
+	g_debug("RadarSite: ingest - %s, %s, %d tilts", site->city->code,
+			site->ingest_name, ingest->tilts);
+	return aweather_ingest_store(ingest, site->city->code);
+}
+
+static gboolean _site_cancelled(RadarSite *site)
+{
+	return site->loading != g_atomic_int_get(&site->serial);
+}
+
+/* Cancel the update in progress, stopping any download */
+static void _site_cancel(RadarSite *site)
+{
+	g_atomic_int_inc(&site->serial);
+	radar_http_abort(site->http, &site->update_http);
+}
+
+/* Add a loaded volume, polls keep showing the old one until the update
+ * ends. Partial volumes from the real-time feed are not tracked or
+ * accumulated until they are complete. */
+static void _site_update_add(RadarSite *site, AWeatherLevel2 *level2,
+		gboolean complete)
+{
+	if (site->polling)
+		site->live = level2;
+	else
+		site->level2 = level2;
+	if (!level2) {
+		site->message = "Load failed";
+		return;
+	}
+	if (_site_cancelled(site))
+		return;
+
+	/* Track storm motion from the previous volume */
+	if (complete)
+		aweather_motion_update(&site->motion, level2->store);
+	level2->motion = &site->motion;
+
+	/* Accumulate rainfall and checkpoint it to the cache */
+	if (!site->rain)
+		site->rain = aweather_rain_new(site->city->code);
+	if (complete && aweather_rain_update(site->rain, level2->store))
+		aweather_rain_save(site->rain);
+	level2->rain = site->rain;
+	grits_object_hide(GRITS_OBJECT(level2), site->hidden ||
+			site->anim != NULL || site->polling);
+	grits_viewer_add(site->viewer, GRITS_OBJECT(level2),
+			GRITS_LEVEL_WORLD+3, TRUE);
+}
+
+void _site_update_thread(gpointer _site, gpointer _unused)
 {
 	RadarSite *site = _site;
 	g_debug("RadarSite: update_thread - %s", site->city->code);
 	site->message = NULL;
+	time_t time   = site->time;
+	if (_site_cancelled(site))
+		goto out;
 
 	gboolean offline = grits_viewer_get_offline(site->viewer);
 	gchar *nexrad_url = grits_prefs_get_string(site->prefs,
 			"aweather/nexrad_url", NULL);
 
+	/* Abort a prefetch of this site and wait for it to stop downloading */
+	g_mutex_lock(&prefetch_lock);
+	while (site->prefetching) {
+		radar_http_abort(site->http, &site->prefetch_http);
+		g_cond_wait(&prefetch_cond, &prefetch_lock);
+	}
+	g_mutex_unlock(&prefetch_lock);
+
 	/* Find nearest volume (temporally) */
 	g_debug("RadarSite: update_thread - find nearest - %s", site->city->code);
-	gchar *dir_list = g_strconcat(nexrad_url, "/", site->city->code,
-			"/", "dir.list", NULL);
-	GList *files = grits_http_available(site->http,
-			"^\\w{4}_\\d{8}_\\d{4}$", site->city->code,
-			"\\d+ (.*)", (offline ? NULL : dir_list));
-	g_free(dir_list);
-	gchar *nearest = _find_nearest(site->time, files, 5);
-	g_list_foreach(files, (GFunc)g_free, NULL);
-	g_list_free(files);
+	GritsHttp *http = NULL;
+	while (!(http = radar_http_lease(site->http, &site->update_http)) &&
+	       !_site_cancelled(site));
+	if (!http) {
+		g_free(nexrad_url);
+		goto out;
+	}
+	_site_list(site, http, nexrad_url, offline);
+	gint   found   = radar_times_nearest(site->times, time);
+	gchar *nearest = found >= 0 ?
+		g_strdup(site->times->files[found].name) : NULL;
+	g_debug("RadarSite: update_thread - nearest = %s", nearest);
+
+	/* Keep the volumes up to the nearest one for looping */
+	g_list_free_full(site->next_names, g_free);
+	site->next_names = radar_times_window(site->times, found, ANIM_MAX_FRAMES-1, 0);
+	site->current = found >= 0 && found == site->times->nfiles-1;
 	if (!nearest) {
 		site->message = "No suitable files found";
+		g_free(nexrad_url);
+		goto out;
+	}
+	if (_site_cancelled(site)) {
+		g_free(nexrad_url);
+		g_free(nearest);
+		goto out;
+	}
+
+	/* Show the volume being scanned, if the real-time feed has one */
+	gchar *chunk_dir = grits_prefs_get_string(site->prefs,
+			"aweather/chunk_dir", NULL);
+	AWeatherStore *live = !offline && site->current && chunk_dir && *chunk_dir ?
+		_site_ingest(site, chunk_dir, nearest) : NULL;
+	g_free(chunk_dir);
+	if (live || site->polling) {
+		g_free(nexrad_url);
+		g_free(nearest);
+		if (!live)
+			goto out;
+		g_debug("RadarSite: update_thread - live - %s", site->city->code);
+		_site_update_add(site, aweather_level2_new_from_store(live, colormaps),
+				site->ingest->done);
 		goto out;
 	}
 
-	/* Fetch new volume */
+	/* Fetch new volume, new downloads are written to a .part file
+	 * which is checked for a quick look while downloading */
 	g_debug("RadarSite: update_thread - fetch");
 	gchar *local = g_strconcat(site->city->code, "/", nearest, NULL);
 	gchar *uri   = g_strconcat(nexrad_url, "/", local,   NULL);
-	gchar *file  = grits_http_fetch(site->http, uri, local,
+	gchar *path  = g_build_filename(g_get_user_cache_dir(), "grits",
+			"nexrad", "level2", site->city->code, nearest, NULL);
+	gchar *partial   = g_strconcat(path, ".part", NULL);
+	site->partial    = aweather_quick_new(partial);
+	site->quick_next = QUICK_STEP;
+	g_free(partial);
+	gboolean cached  = g_file_test(path, G_FILE_TEST_EXISTS);
+	gchar *file  = grits_http_fetch(http, uri, local,
 			offline ? GRITS_LOCAL : GRITS_UPDATE,
 			_site_update_loading, site);
+	radar_http_release(site->http, &site->update_http);
+	aweather_quick_free(site->partial);
+	site->partial = NULL;
+	if (file) {
+		g_atomic_int_inc(&cache_loads);
+		if (cached)
+			g_atomic_int_inc(&cache_hits);
+		g_debug("RadarSite: update_thread - cache %s, %d of %d loads cached",
+				cached ? "hit" : "miss",
+				g_atomic_int_get(&cache_hits),
+				g_atomic_int_get(&cache_loads));
+	}
+	g_free(path);
 	g_free(nexrad_url);
 	g_free(nearest);
 	g_free(local);
@@ -182,35 +784,37 @@ gpointer _site_update_thread(gpointer _site)
 		site->message = "Fetch failed";
 		goto out;
 	}
+	if (_site_cancelled(site)) {
+		g_free(file);
+		goto out;
+	}
 
 	/* Load and add new volume */
 	g_debug("RadarSite: update_thread - load - %s", site->city->code);
-	site->level2 = aweather_level2_new_from_file(
-			file, site->city->code, colormaps);
+	_site_update_add(site, aweather_level2_new_from_file(
+			file, site->city->code, colormaps), TRUE);
 	g_free(file);
-	if (!site->level2) {
-		site->message = "Load failed";
-		goto out;
-	}
-	grits_object_hide(GRITS_OBJECT(site->level2), site->hidden);
-	grits_viewer_add(site->viewer, GRITS_OBJECT(site->level2),
-			GRITS_LEVEL_WORLD+3, TRUE);
 
 out:
+	radar_http_release(site->http, &site->update_http);
 	if (!site->idle_source)
 		site->idle_source = g_idle_add(_site_update_end, site);
-	return NULL;
 }
 void _site_update(RadarSite *site)
 {
-	if (site->status == STATUS_LOADING)
-		return;
-	site->status = STATUS_LOADING;
-
 	site->time = grits_viewer_get_time(site->viewer);
 	g_debug("RadarSite: update %s - %d",
 			site->city->code, (gint)site->time);
 
+	/* The newest time wins, a load in progress is cancelled and
+	 * restarted once it gets back to the main thread */
+	if (site->status == STATUS_LOADING) {
+		_site_cancel(site);
+		return;
+	}
+	g_atomic_int_inc(&site->serial);
+	site->status = STATUS_LOADING;
+
 	/* Add a progress bar */
 	GtkWidget *progress = gtk_progress_bar_new();
 	gtk_progress_bar_set_text(GTK_PROGRESS_BAR(progress), "Loading...");
@@ -219,17 +823,41 @@ void _site_update(RadarSite *site)
 	/* Remove old volume */
 	g_debug("RadarSite: update - remove - %s", site->city->code);
 	grits_object_destroy_pointer(&site->level2);
+	grits_object_destroy_pointer(&site->quick);
 
-	/* Fork loading right away so updating the
+	/* Queue loading right away so updating the
 	 * list of times doesn't take too long */
-	g_thread_new("site-update-thread", _site_update_thread, site);
+	_site_update_push(site);
+}
+
+/* Look for new chunks in the real-time feed without clearing the volume
+ * that is shown, this is skipped while updating or looking at the past */
+static gboolean _site_poll(gpointer _site)
+{
+	RadarSite *site = _site;
+	if (site->status != STATUS_LOADED || !site->current)
+		return TRUE;
+	g_debug("RadarSite: poll - %s", site->city->code);
+	g_atomic_int_inc(&site->serial);
+	site->status  = STATUS_LOADING;
+	site->polling = TRUE;
+	_site_update_push(site);
+	return TRUE;
 }
 
 /* RadarSite methods */
 void radar_site_unload(RadarSite *site)
 {
-	if (site->status != STATUS_LOADED)
-		return; // Abort if it's still loading
+	if (site->status == STATUS_UNLOADED)
+		return;
+
+	/* Cancel loading, the site is unloaded once the update ends */
+	if (site->status == STATUS_LOADING) {
+		g_debug("RadarSite: unload %s - cancel", site->city->code);
+		site->unload = TRUE;
+		_site_cancel(site);
+		return;
+	}
 
 	g_debug("RadarSite: unload %s", site->city->code);
 
@@ -237,8 +865,11 @@ void radar_site_unload(RadarSite *site)
 		g_signal_handler_disconnect(site->viewer, site->time_id);
 	if (site->refresh_id)
 		g_signal_handler_disconnect(site->viewer, site->refresh_id);
+	if (site->poll_id)
+		g_source_remove(site->poll_id);
 	if (site->idle_source)
 		g_source_remove(site->idle_source);
+	site->poll_id     = 0;
 	site->idle_source = 0;
 
 	/* Remove tab */
@@ -246,7 +877,20 @@ void radar_site_unload(RadarSite *site)
 		gtk_widget_destroy(site->config);
 
 	/* Remove radar */
+	_site_anim_stop(site);
 	grits_object_destroy_pointer(&site->level2);
+	grits_object_destroy_pointer(&site->live);
+	aweather_mosaic_remove(site->mosaic, site->city->code);
+	if (site->ingest)
+		aweather_ingest_free(site->ingest);
+	g_free(site->ingest_name);
+	site->ingest      = NULL;
+	site->ingest_name = NULL;
+	site->polling     = FALSE;
+	aweather_motion_clear(&site->motion);
+	if (site->rain)
+		aweather_rain_free(site->rain);
+	site->rain = NULL;
 
 	site->status = STATUS_UNLOADED;
 }
@@ -269,27 +913,27 @@ void radar_site_load(RadarSite *site)
 			G_CALLBACK(_site_update), site);
 	site->refresh_id = g_signal_connect_swapped(site->viewer, "refresh",
 			G_CALLBACK(_site_update), site);
+	gchar *chunk_dir = grits_prefs_get_string(site->prefs, "aweather/chunk_dir", NULL);
+	gint   poll      = grits_prefs_get_integer(site->prefs, "aweather/chunk_poll", NULL);
+	if (chunk_dir && *chunk_dir)
+		site->poll_id = g_timeout_add_seconds(poll > 0 ? poll : 10,
+				_site_poll, site);
+	g_free(chunk_dir);
 	_site_update(site);
 }
 
-void _site_on_location_changed(GritsViewer *viewer,
-		gdouble lat, gdouble lon, gdouble elev,
-		gpointer _site)
-{
-	static gdouble min_dist = EARTH_R / 30;
-	RadarSite *site = _site;
-
-	/* Calculate distance, could cache xyz values */
-	gdouble eye_xyz[3], site_xyz[3];
-	lle2xyz(lat, lon, elev, &eye_xyz[0], &eye_xyz[1], &eye_xyz[2]);
-	lle2xyz(site->city->pos.lat, site->city->pos.lon, site->city->pos.elev,
-			&site_xyz[0], &site_xyz[1], &site_xyz[2]);
-	gdouble dist = distd(site_xyz, eye_xyz);
+/* Sites are loaded within SITE_LOAD_DIST of the eye and
+ * unloaded once they are more than twice that away */
+#define SITE_LOAD_DIST (EARTH_R / 30)
 
-	/* Load or unload the site if necessasairy */
-	if (dist <= min_dist && dist < elev*1.25 && site->status == STATUS_UNLOADED)
+/* Load or unload the site if necessasairy */
+static void _site_set_distance(RadarSite *site, gdouble dist, gdouble elev)
+{
+	if (dist <= SITE_LOAD_DIST && dist < elev*1.25 && site->status == STATUS_UNLOADED)
 		radar_site_load(site);
-	else if (dist > 2*min_dist &&  site->status != STATUS_UNLOADED)
+	else if (dist <= SITE_LOAD_DIST && dist < elev*1.25 && site->unload)
+		site->unload = FALSE; // Needed again before the cancel finished
+	else if (dist > 2*SITE_LOAD_DIST && site->status != STATUS_UNLOADED)
 		radar_site_unload(site);
 }
 
@@ -312,23 +956,20 @@ static gboolean on_marker_clicked(GritsObject *marker, GdkEvent *event, RadarSit
 }
 
 RadarSite *radar_site_new(city_t *city, GtkWidget *pconfig,
-		GritsViewer *viewer, GritsPrefs *prefs, GritsHttp *http)
+		GritsViewer *viewer, GritsPrefs *prefs, RadarHttp *http,
+		AWeatherMosaic *mosaic, GThreadPool *pool)
 {
 	RadarSite *site = g_new0(RadarSite, 1);
 	site->viewer  = g_object_ref(viewer);
 	site->prefs   = g_object_ref(prefs);
-	//site->http    = http;
-	site->http    = grits_http_new(G_DIR_SEPARATOR_S
-			"nexrad" G_DIR_SEPARATOR_S
-			"level2" G_DIR_SEPARATOR_S);
+	site->http    = http;
 	site->city    = city;
 	site->pconfig = pconfig;
+	site->mosaic  = mosaic;
+	site->pool    = pool;
 	site->hidden  = TRUE;
-
-	/* Set initial location */
-	gdouble lat, lon, elev;
-	grits_viewer_get_location(viewer, &lat, &lon, &elev);
-	_site_on_location_changed(viewer, lat, lon, elev, site);
+	lle2xyz(city->pos.lat, city->pos.lon, city->pos.elev,
+			&site->xyz[0], &site->xyz[1], &site->xyz[2]);
 
 	/* Add marker */
 	site->marker = grits_marker_new(site->city->name);
@@ -339,20 +980,20 @@ RadarSite *radar_site_new(city_t *city, GtkWidget *pconfig,
 	g_signal_connect(site->marker, "clicked",
 			G_CALLBACK(on_marker_clicked), site);
 	grits_object_set_cursor(GRITS_OBJECT(site->marker), GDK_HAND2);
-
-	/* Connect signals */
-	site->location_id  = g_signal_connect(viewer, "location-changed",
-			G_CALLBACK(_site_on_location_changed), site);
 	return site;
 }
 
 void radar_site_free(RadarSite *site)
 {
+	/* The update pool is stopped first, so nothing is still loading */
+	if (site->status == STATUS_LOADING)
+		site->status = STATUS_LOADED;
 	radar_site_unload(site);
 	grits_object_destroy_pointer(&site->marker);
-	if (site->location_id)
-		g_signal_handler_disconnect(site->viewer, site->location_id);
-	grits_http_free(site->http);
+	g_list_free_full(site->names, g_free);
+	g_list_free_full(site->next_names, g_free);
+	if (site->times)
+		radar_times_free(site->times);
 	g_object_unref(site->viewer);
 	g_object_unref(site->prefs);
 	g_free(site);
@@ -367,9 +1008,18 @@ void radar_site_free(RadarSite *site)
 #define CONUS_WIDTH       3400.0
 #define CONUS_HEIGHT      1600.0
 #define CONUS_DEG_PER_PX  0.017971305190311
+#define CONUS_MAX_FRAMES  24
+
+/* Image kept for the loop as palette indices, about 5 MB */
+typedef struct {
+	gchar       *name;
+	AWeatherGif *gif;
+	guint32      colors[256]; // Mapped RGBA for each palette entry
+} ConusFrame;
 
 struct _RadarConus {
 	GritsViewer *viewer;
+	GritsPrefs  *prefs;
 	GritsHttp   *http;
 	GtkWidget   *config;
 	time_t       time;
@@ -377,11 +1027,29 @@ struct _RadarConus {
 	GMutex       loading;
 
 	gchar       *path;
+	guchar      *pixels[2];   // West and east halves, decoded by the thread
 	GritsTile   *tile[2];
 
+	/* Loop */
+	GritsHttp   *loop_http;   // Used by the loop thread
+	GMutex       loop_loading;
+	GMutex       loop_lock;   // Held while changing the frames, time or looping
+	gboolean     looping;
+	gboolean     loop_reload; // The loop thread should run again for a new time
+	ConusFrame  *frames[CONUS_MAX_FRAMES]; // Oldest first
+	gint         nframes;
+	gint         shown;       // Frame on screen
+	GThreadPool *loop_pool;   // Expands the next frame into loop_pixels
+	gboolean     loop_ready;  // loop_pixels hold frame loop_next
+	gint         loop_next;
+	gchar       *loop_name;
+	guchar      *loop_pixels[2];
+	guchar      *uploaded[2]; // Halves in the textures, for finding changes
+
 	guint        time_id;     // "time-changed"     callback ID
 	guint        refresh_id;  // "refresh"          callback ID
 	guint        idle_source; // _conus_update_end idle source
+	guint        play_id;     // _conus_loop_play timeout source
 };
 
 void _conus_update_loading(gchar *file, goffset cur,
@@ -397,21 +1065,59 @@ void _conus_update_loading(gchar *file, goffset cur,
 	g_free(msg);
 }
 
-/* Copy images to graphics memory */
-static void _conus_update_end_copy(GritsTile *tile, guchar *pixels)
-{
-	if (!tile->tex)
-		glGenTextures(1, &tile->tex);
+#define CONUS_BAND 32 // Rows compared at a time for changes
 
-	gchar *clear = g_malloc0(2048*2048*4);
-	glBindTexture(GL_TEXTURE_2D, tile->tex);
+/* Upload the parts of a half that changed since prev, each band of rows
+ * is uploaded from its first to its last changed column. Returns the
+ * number of bytes uploaded. */
+static gsize _conus_update_end_dirty(const guint32 *pixels, const guint32 *prev)
+{
+	gint  width = CONUS_WIDTH/2, height = CONUS_HEIGHT;
+	gsize bytes = 0;
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+	for (gint y0 = 0; y0 < height; y0 += CONUS_BAND) {
+		gint y1 = MIN(y0 + CONUS_BAND, height);
+		gint x0 = width, x1 = 0;
+		for (gint y = y0; y < y1; y++) {
+			const guint32 *a = &pixels[y*width], *b = &prev[y*width];
+			for (gint x = 0; x < x0; x++)
+				if (a[x] != b[x]) { x0 = x; break; }
+			for (gint x = width-1; x >= MAX(x0, x1); x--)
+				if (a[x] != b[x]) { x1 = x+1; break; }
+		}
+		if (x0 >= x1)
+			continue;
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 1+x0,1+y0, x1-x0,y1-y0,
+				GL_RGBA, GL_UNSIGNED_BYTE, &pixels[y0*width+x0]);
+		bytes += (gsize)(x1-x0)*(y1-y0)*4;
+	}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	return bytes;
+}
 
+/* Copy images to graphics memory, the texture is only allocated and
+ * cleared the first time so later images just replace the pixels.
+ * With prev, the image in the texture, only the changes are uploaded. */
+static gsize _conus_update_end_copy(GritsTile *tile, guchar *pixels, guchar *prev)
+{
+	gsize bytes = (gsize)(CONUS_WIDTH/2)*CONUS_HEIGHT*4;
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 	glPixelStorei(GL_PACK_ALIGNMENT, 1);
-	glTexImage2D(GL_TEXTURE_2D, 0, 4, 2048, 2048, 0,
-			GL_RGBA, GL_UNSIGNED_BYTE, clear);
-	glTexSubImage2D(GL_TEXTURE_2D, 0, 1,1, CONUS_WIDTH/2,CONUS_HEIGHT,
-			GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	if (!tile->tex) {
+		gchar *clear = g_malloc0(2048*2048*4);
+		glGenTextures(1, &tile->tex);
+		glBindTexture(GL_TEXTURE_2D, tile->tex);
+		glTexImage2D(GL_TEXTURE_2D, 0, 4, 2048, 2048, 0,
+				GL_RGBA, GL_UNSIGNED_BYTE, clear);
+		g_free(clear);
+		prev = NULL;
+	}
+	glBindTexture(GL_TEXTURE_2D, tile->tex);
+	if (prev)
+		bytes = _conus_update_end_dirty((guint32*)pixels, (guint32*)prev);
+	else
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 1,1, CONUS_WIDTH/2,CONUS_HEIGHT,
+				GL_RGBA, GL_UNSIGNED_BYTE, pixels);
 	tile->coords.n = 1.0/(CONUS_WIDTH/2);
 	tile->coords.w = 1.0/ CONUS_HEIGHT;
 	tile->coords.s = tile->coords.n +  CONUS_HEIGHT   / 2048.0;
@@ -421,7 +1127,51 @@ static void _conus_update_end_copy(GritsTile *tile, guchar *pixels)
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glFlush();
-	g_free(clear);
+	return bytes;
+}
+
+/* Copy both halves, the halves in the textures are kept for finding what
+ * changed next time and the old ones are swapped into pixels. */
+static void _conus_update_end_upload(RadarConus *conus, guchar *pixels[2])
+{
+	gboolean dirty = grits_prefs_get_boolean(conus->prefs, "aweather/conus_dirty", NULL);
+	gint64   start = g_get_monotonic_time();
+	gsize    bytes = 0;
+	for (gint i = 0; i < 2; i++) {
+		bytes += _conus_update_end_copy(conus->tile[i], pixels[i],
+				dirty ? conus->uploaded[i] : NULL);
+		guchar *old = conus->uploaded[i];
+		conus->uploaded[i] = pixels[i];
+		pixels[i] = old;
+	}
+	g_debug("Conus: update_end_upload - %.1f MB, %.1f ms",
+			bytes / 1000000.0, (g_get_monotonic_time() - start) / 1000.0);
+}
+
+/* Map a color from the image, the background is made transparent
+ * and the weakest echoes partly transparent */
+static void _conus_color(const guchar *src, guchar *dst)
+{
+	const guchar alphamap[][4] = {
+		{0x04, 0xe9, 0xe7, 0x30},
+		{0x01, 0x9f, 0xf4, 0x60},
+		{0x03, 0x00, 0xf4, 0x90},
+	};
+	if (src[0] > 0xe0 &&
+	    src[1] > 0xe0 &&
+	    src[2] > 0xe0) {
+		dst[0] = dst[1] = dst[2] = dst[3] = 0x00;
+	} else {
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+		dst[3] = 0xff * 0.75;
+		for (int j = 0; j < G_N_ELEMENTS(alphamap); j++)
+			if (src[0] == alphamap[j][0] &&
+			    src[1] == alphamap[j][1] &&
+			    src[2] == alphamap[j][2])
+				dst[3] = alphamap[j][3];
+	}
 }
 
 /* Split the pixbuf into east and west halves (with 2K sides)
@@ -431,35 +1181,365 @@ static void _conus_update_end_split(guchar *pixels, guchar *west, guchar *east,
 {
 	g_debug("Conus: update_end_split");
 	guchar *out[] = {west,east};
-	const guchar alphamap[][4] = {
-		{0x04, 0xe9, 0xe7, 0x30},
-		{0x01, 0x9f, 0xf4, 0x60},
-		{0x03, 0x00, 0xf4, 0x90},
-	};
 	for (int y = 0; y < height; y++)
 	for (int x = 0; x < width;  x++) {
 		gint subx = x % (width/2);
 		gint idx  = x / (width/2);
 		guchar *src = &pixels[(y*width+x)*pxsize];
 		guchar *dst = &out[idx][(y*(width/2)+subx)*4];
-		if (src[0] > 0xe0 &&
-		    src[1] > 0xe0 &&
-		    src[2] > 0xe0) {
-			dst[3] = 0x00;
-		} else {
-			dst[0] = src[0];
-			dst[1] = src[1];
-			dst[2] = src[2];
-			dst[3] = 0xff * 0.75;
-			for (int j = 0; j < G_N_ELEMENTS(alphamap); j++)
-				if (src[0] == alphamap[j][0] &&
-				    src[1] == alphamap[j][1] &&
-				    src[2] == alphamap[j][2])
-					dst[3] = alphamap[j][3];
+		_conus_color(src, dst);
+	}
+}
+
+/* Rows of a paletted image for one thread to split */
+typedef struct {
+	const guint8  *index;
+	const guint32 *colors;
+	guint32       *west, *east;
+	gint           width, y0, y1;
+} ConusSplit;
+
+static gpointer _conus_split_rows(gpointer _split)
+{
+	ConusSplit *split = _split;
+	gint        half  = split->width/2;
+	for (gint y = split->y0; y < split->y1; y++) {
+		const guint8 *src  = &split->index[y*split->width];
+		guint32      *west = &split->west[y*half];
+		guint32      *east = &split->east[y*half];
+		for (gint x = 0; x < half; x++)
+			west[x] = split->colors[src[x]];
+		for (gint x = 0; x < half; x++)
+			east[x] = split->colors[src[half+x]];
+	}
+	return NULL;
+}
+
+/* Map each palette entry of an image */
+static void _conus_colors(AWeatherGif *gif, guint32 colors[256])
+{
+	memset(colors, 0, 256*sizeof(guint32));
+	for (gint i = 0; i < gif->ncolors; i++)
+		_conus_color(gif->palette[i], (guchar*)&colors[i]);
+}
+
+/* Split a paletted image, the colors are only mapped once for each
+ * palette entry and each pixel is a table lookup */
+static void _conus_update_end_split_gif(AWeatherGif *gif, const guint32 *colors,
+		guchar *west, guchar *east)
+{
+	g_debug("Conus: update_end_split_gif");
+
+	/* Split the rows between threads */
+	gint       nthreads = CLAMP(g_get_num_processors(), 1, 8);
+	GThread   *threads[8];
+	ConusSplit splits[8];
+	for (gint i = 0; i < nthreads; i++) {
+		splits[i] = (ConusSplit){gif->pixels, colors,
+			(guint32*)west, (guint32*)east, gif->width,
+			gif->height*i/nthreads, gif->height*(i+1)/nthreads};
+		threads[i] = i == 0 ? NULL :
+			g_thread_new("conus-split-thread", _conus_split_rows, &splits[i]);
+	}
+	_conus_split_rows(&splits[0]);
+	for (gint i = 1; i < nthreads; i++)
+		g_thread_join(threads[i]);
+}
+
+#define CONUS_URL "http://radar.weather.gov/Conus/RadarImg/"
+
+/* Names of the images up to a time, oldest first */
+static GList *_conus_names(RadarConus *conus, GritsHttp *http,
+		time_t now, gint count, gboolean offline)
+{
+	GList *names = NULL;
+	if (time(NULL) - now < 60*60*5 && !offline) {
+		/* radar.weather.gov is full of lies.
+		 * the index pages get cached and out of date */
+		/* gmtime is not thread safe, but it's not used very often so
+		 * hopefully it'll be alright for now... :-( */
+		struct tm *tm = gmtime(&now);
+		time_t onthe8 = now - 60*((tm->tm_min+1)%10+1);
+		for (gint i = 0; i < count; i++) {
+			time_t when = onthe8 - i*10*60;
+			tm = gmtime(&when);
+			names = g_list_prepend(names, g_strdup_printf(
+					"Conus_%04d%02d%02d_%02d%02d_N0Ronly.gif",
+					tm->tm_year+1900, tm->tm_mon+1, tm->tm_mday,
+					tm->tm_hour, tm->tm_min));
+		}
+	} else {
+		GList *files = grits_http_available(http,
+				"^Conus_[^\"]*_N0Ronly.gif$", "", NULL, NULL);
+		RadarTimeIndex *times = radar_times_new(files, 6);
+		gint            found = radar_times_nearest(times, now);
+		names = radar_times_window(times, found, count-1, 0);
+		radar_times_free(times);
+		g_list_foreach(files, (GFunc)g_free, NULL);
+		g_list_free(files);
+	}
+	return names;
+}
+
+/********
+ * Loop *
+ ********/
+/* The loop keeps the most recent images as palette indices, which are a
+ * quarter of the size of the RGBA halves. Missing frames are fetched and
+ * decoded by a background thread while the frames that are ready play. */
+static void _conus_frame_free(ConusFrame *frame)
+{
+	aweather_gif_free(frame->gif);
+	g_free(frame->name);
+	g_free(frame);
+}
+
+static gboolean _conus_loop_has(RadarConus *conus, const gchar *name)
+{
+	gboolean found = FALSE;
+	g_mutex_lock(&conus->loop_lock);
+	for (gint i = 0; i < conus->nframes && !found; i++)
+		found = g_strcmp0(conus->frames[i]->name, name) == 0;
+	g_mutex_unlock(&conus->loop_lock);
+	return found;
+}
+
+/* Drop frames that are no longer wanted */
+static void _conus_loop_keep(RadarConus *conus, GList *names)
+{
+	g_mutex_lock(&conus->loop_lock);
+	gint n = 0;
+	for (gint i = 0; i < conus->nframes; i++) {
+		if (conus->looping && g_list_find_custom(names,
+				conus->frames[i]->name, (GCompareFunc)g_strcmp0))
+			conus->frames[n++] = conus->frames[i];
+		else
+			_conus_frame_free(conus->frames[i]);
+	}
+	conus->nframes = n;
+	conus->shown   = MIN(conus->shown, MAX(n-1, 0));
+	g_mutex_unlock(&conus->loop_lock);
+}
+
+/* Add a frame in time order, names sort by time */
+static void _conus_loop_add(RadarConus *conus, ConusFrame *frame)
+{
+	g_mutex_lock(&conus->loop_lock);
+	if (!conus->looping || conus->nframes >= CONUS_MAX_FRAMES) {
+		_conus_frame_free(frame);
+	} else {
+		gint i = conus->nframes;
+		while (i > 0 && strcmp(conus->frames[i-1]->name, frame->name) > 0) {
+			conus->frames[i] = conus->frames[i-1];
+			i--;
 		}
+		conus->frames[i] = frame;
+		conus->nframes++;
+	}
+	g_mutex_unlock(&conus->loop_lock);
+}
+
+static gboolean _conus_loop_looping(RadarConus *conus)
+{
+	g_mutex_lock(&conus->loop_lock);
+	gboolean looping = conus->looping;
+	g_mutex_unlock(&conus->loop_lock);
+	return looping;
+}
+
+/* Fetch the frames up to a time that the loop doesn't have yet */
+static void _conus_loop_fetch(RadarConus *conus, time_t now,
+		gint count, gboolean offline)
+{
+	GList *names = _conus_names(conus, conus->loop_http, now, count, offline);
+	_conus_loop_keep(conus, names);
+
+	/* Newest first, so the loop fills in backwards from the current time */
+	names = g_list_reverse(names);
+	for (GList *cur = names; cur && _conus_loop_looping(conus); cur = cur->next) {
+		gchar *name = cur->data;
+		if (_conus_loop_has(conus, name))
+			continue;
+		gchar *uri  = g_strconcat(CONUS_URL, name, NULL);
+		gchar *path = grits_http_fetch(conus->loop_http, uri, name,
+				offline ? GRITS_LOCAL : GRITS_ONCE, NULL, NULL);
+		AWeatherGif *gif = path ? aweather_gif_load(path) : NULL;
+		g_free(uri);
+		g_free(path);
+		if (!gif)
+			continue;
+		ConusFrame *frame = g_new0(ConusFrame, 1);
+		frame->name = g_strdup(name);
+		frame->gif  = gif;
+		_conus_colors(gif, frame->colors);
+		_conus_loop_add(conus, frame);
+	}
+	g_list_free_full(names, g_free);
+}
+
+/* Runs until no reload is wanted, loop_loading is unlocked while still
+ * holding loop_lock so a reload asked for meanwhile starts a new thread */
+static gpointer _conus_loop_thread(gpointer _conus)
+{
+	RadarConus *conus = _conus;
+	gboolean offline = grits_viewer_get_offline(conus->viewer);
+	gint     count   = grits_prefs_get_integer(conus->prefs, "aweather/conus_frames", NULL);
+	count = CLAMP(count, 2, CONUS_MAX_FRAMES);
+
+	g_mutex_lock(&conus->loop_lock);
+	while (conus->looping && conus->loop_reload) {
+		time_t now = conus->time;
+		conus->loop_reload = FALSE;
+		g_mutex_unlock(&conus->loop_lock);
+		g_debug("Conus: loop_thread - %d frames, %d", count, (gint)now);
+		_conus_loop_fetch(conus, now, count, offline);
+		g_mutex_lock(&conus->loop_lock);
+	}
+	g_debug("Conus: loop_thread - done");
+	g_mutex_unlock(&conus->loop_loading);
+	g_mutex_unlock(&conus->loop_lock);
+	return NULL;
+}
+
+/* Ask the loop thread to load the frames up to the current time, it is
+ * started if it isn't already running */
+static void _conus_loop_load(RadarConus *conus)
+{
+	g_mutex_lock(&conus->loop_lock);
+	conus->time        = grits_viewer_get_time(conus->viewer);
+	conus->loop_reload = TRUE;
+	if (g_mutex_trylock(&conus->loop_loading))
+		g_thread_new("conus-loop-thread", _conus_loop_thread, conus);
+	g_mutex_unlock(&conus->loop_lock);
+}
+
+/* Expand the frame after the one shown into the halves, this runs on the
+ * loop pool so the main thread only has to upload them. The buffers are
+ * reused for every frame. */
+static void _conus_loop_expand(gpointer _conus, gpointer _unused)
+{
+	RadarConus *conus = _conus;
+	g_mutex_lock(&conus->loop_lock);
+	if (!conus->looping || conus->loop_ready || conus->nframes == 0) {
+		g_mutex_unlock(&conus->loop_lock);
+		return;
 	}
+	gint         next  = (conus->shown + 1) % conus->nframes;
+	ConusFrame  *frame = conus->frames[next];
+	AWeatherGif *gif   = frame->gif;
+	if (gif->width == CONUS_WIDTH && gif->height == CONUS_HEIGHT) {
+		for (gint i = 0; i < 2; i++)
+			if (!conus->loop_pixels[i])
+				conus->loop_pixels[i] = g_malloc(4*(gif->width/2)*gif->height);
+		_conus_update_end_split_gif(gif, frame->colors,
+				conus->loop_pixels[0], conus->loop_pixels[1]);
+		g_free(conus->loop_name);
+		conus->loop_name  = g_strdup(frame->name);
+		conus->loop_ready = TRUE;
+	}
+	conus->loop_next = next;
+	if (!conus->loop_ready)
+		conus->shown = next; // Skip frames that can't be shown
+	g_mutex_unlock(&conus->loop_lock);
+}
+
+/* Show the frame expanded by the loop pool and queue the one after it, the
+ * tick is skipped if the pool isn't done yet */
+static gboolean _conus_loop_play(gpointer _conus)
+{
+	RadarConus *conus = _conus;
+	if (!g_mutex_trylock(&conus->loop_lock))
+		return TRUE;
+	gboolean ready = conus->loop_ready;
+	gchar   *label = ready ? g_strdup(conus->loop_name) : NULL;
+	if (ready)
+		conus->shown = MIN(conus->loop_next, MAX(conus->nframes-1, 0));
+	g_mutex_unlock(&conus->loop_lock);
+
+	/* The pool leaves the halves alone until they're marked as used */
+	if (ready) {
+		_conus_update_end_upload(conus, conus->loop_pixels);
+		g_mutex_lock(&conus->loop_lock);
+		conus->loop_ready = FALSE;
+		g_mutex_unlock(&conus->loop_lock);
+		GtkWidget *box = gtk_bin_get_child(GTK_BIN(conus->config));
+		GtkWidget *text = box ? g_object_get_data(G_OBJECT(box), "label") : NULL;
+		if (text)
+			gtk_label_set_text(GTK_LABEL(text), label);
+		grits_viewer_queue_draw(conus->viewer);
+		g_free(label);
+	}
+	if (g_thread_pool_unprocessed(conus->loop_pool) == 0)
+		g_thread_pool_push(conus->loop_pool, conus, NULL);
+	return TRUE;
+}
+
+static void _conus_update(RadarConus *conus);
+
+static void _conus_loop_start(RadarConus *conus)
+{
+	if (conus->looping)
+		return;
+	g_debug("Conus: loop_start");
+	gdouble fps = grits_prefs_get_double(conus->prefs, "aweather/anim_fps", NULL);
+	g_mutex_lock(&conus->loop_lock);
+	conus->looping = TRUE;
+	conus->shown   = 0;
+	g_mutex_unlock(&conus->loop_lock);
+	conus->play_id = g_timeout_add(1000 / (fps > 0 ? fps : 4),
+			_conus_loop_play, conus);
+	_conus_loop_load(conus);
+}
+
+/* Frames are freed by the loop thread if it is still running */
+static void _conus_loop_stop(RadarConus *conus)
+{
+	if (!conus->looping)
+		return;
+	g_debug("Conus: loop_stop");
+	g_mutex_lock(&conus->loop_lock);
+	conus->looping = FALSE;
+	g_mutex_unlock(&conus->loop_lock);
+	if (conus->play_id)
+		g_source_remove(conus->play_id);
+	conus->play_id = 0;
+	grits_http_abort(conus->loop_http);
+	_conus_loop_keep(conus, NULL);
+	g_mutex_lock(&conus->loop_lock);
+	for (gint i = 0; i < 2; i++) {
+		g_free(conus->loop_pixels[i]);
+		conus->loop_pixels[i] = NULL;
+	}
+	conus->loop_ready = FALSE;
+	g_mutex_unlock(&conus->loop_lock);
+	_conus_update(conus);
+}
+
+static void _conus_loop_toggled(GtkToggleButton *button, gpointer _conus)
+{
+	RadarConus *conus = _conus;
+	if (gtk_toggle_button_get_active(button))
+		_conus_loop_start(conus);
+	else
+		_conus_loop_stop(conus);
 }
 
+static GtkWidget *_conus_loop_config(RadarConus *conus, const gchar *name)
+{
+	GtkWidget *box    = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
+	GtkWidget *label  = gtk_label_new(name);
+	GtkWidget *button = gtk_toggle_button_new_with_label("Loop");
+	gtk_widget_set_size_request(button, 50, 26);
+	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(button), conus->looping);
+	g_signal_connect(button, "toggled", G_CALLBACK(_conus_loop_toggled), conus);
+	g_object_set_data(G_OBJECT(box), "label", label);
+	gtk_box_pack_start(GTK_BOX(box), label,  FALSE, FALSE, 5);
+	gtk_box_pack_start(GTK_BOX(box), button, FALSE, FALSE, 0);
+	return box;
+}
+
+/* Only the upload to graphics memory is left for the main thread, the
+ * image is decoded and split by _conus_update_thread */
 gboolean _conus_update_end(gpointer _conus)
 {
 	RadarConus *conus = _conus;
@@ -472,42 +1552,23 @@ gboolean _conus_update_end(gpointer _conus)
 		goto out;
 	}
 
-	/* Load and pixbuf */
-	GError *error = NULL;
-	GdkPixbuf *pixbuf = gdk_pixbuf_new_from_file(conus->path, &error);
-	if (!pixbuf || error) {
-		g_warning("Conus: update_end - error loading pixbuf: %s", conus->path);
-		aweather_bin_set_child(GTK_BIN(conus->config), gtk_label_new("Error loading pixbuf"));
-		g_remove(conus->path);
-		goto out;
-	}
-
-	/* Split pixels into east/west parts */
-	guchar *pixels = gdk_pixbuf_get_pixels(pixbuf);
-	gint    width  = gdk_pixbuf_get_width(pixbuf);
-	gint    height = gdk_pixbuf_get_height(pixbuf);
-	gint    pxsize = gdk_pixbuf_get_has_alpha(pixbuf) ? 4 : 3;
-	guchar *pixels_west = g_malloc(4*(width/2)*height);
-	guchar *pixels_east = g_malloc(4*(width/2)*height);
-	_conus_update_end_split(pixels, pixels_west, pixels_east,
-			width, height, pxsize);
-	g_object_unref(pixbuf);
-
 	/* Copy pixels to graphics memory */
-	_conus_update_end_copy(conus->tile[0], pixels_west);
-	_conus_update_end_copy(conus->tile[1], pixels_east);
-	g_free(pixels_west);
-	g_free(pixels_east);
+	_conus_update_end_upload(conus, conus->pixels);
 
 	/* Update GUI */
 	gchar *label = g_path_get_basename(conus->path);
-	aweather_bin_set_child(GTK_BIN(conus->config), gtk_label_new(label));
+	aweather_bin_set_child(GTK_BIN(conus->config), _conus_loop_config(conus, label));
 	grits_viewer_queue_draw(conus->viewer);
 	g_free(label);
 
 out:
 	conus->idle_source = 0;
 	g_free(conus->path);
+	g_free(conus->pixels[0]);
+	g_free(conus->pixels[1]);
+	conus->path      = NULL;
+	conus->pixels[0] = NULL;
+	conus->pixels[1] = NULL;
 	g_mutex_unlock(&conus->loading);
 	return FALSE;
 }
@@ -520,29 +1581,13 @@ gpointer _conus_update_thread(gpointer _conus)
 	/* Find nearest */
 	g_debug("Conus: update_thread - nearest");
 	gboolean offline = grits_viewer_get_offline(conus->viewer);
-	gchar *conus_url = "http://radar.weather.gov/Conus/RadarImg/";
-	gchar *nearest;
-	if (time(NULL) - conus->time < 60*60*5 && !offline) {
-		/* radar.weather.gov is full of lies.
-		 * the index pages get cached and out of date */
-		/* gmtime is not thread safe, but it's not used very often so
-		 * hopefully it'll be alright for now... :-( */
-		struct tm *tm = gmtime(&conus->time);
-		time_t onthe8 = conus->time - 60*((tm->tm_min+1)%10+1);
-		tm = gmtime(&onthe8);
-		nearest = g_strdup_printf("Conus_%04d%02d%02d_%02d%02d_N0Ronly.gif",
-				tm->tm_year+1900, tm->tm_mon+1, tm->tm_mday,
-				tm->tm_hour, tm->tm_min);
-	} else {
-		GList *files = grits_http_available(conus->http,
-				"^Conus_[^\"]*_N0Ronly.gif$", "", NULL, NULL);
-		nearest = _find_nearest(conus->time, files, 6);
-		g_list_foreach(files, (GFunc)g_free, NULL);
-		g_list_free(files);
-		if (!nearest) {
-			conus->message = "No suitable files";
-			goto out;
-		}
+	gchar *conus_url = CONUS_URL;
+	GList *names = _conus_names(conus, conus->http, conus->time, 1, offline);
+	gchar *nearest = names ? names->data : NULL;
+	g_list_free(names);
+	if (!nearest) {
+		conus->message = "No suitable files";
+		goto out;
 	}
 
 	/* Fetch the image */
@@ -558,6 +1603,50 @@ gpointer _conus_update_thread(gpointer _conus)
 		goto out;
 	}
 
+	/* Decode the image, as palette indices when possible */
+	gint64 start = g_get_monotonic_time();
+	AWeatherGif *gif = aweather_gif_load(conus->path);
+	if (gif) {
+		gint64 decoded = g_get_monotonic_time();
+		guint32 colors[256];
+		_conus_colors(gif, colors);
+		conus->pixels[0] = g_malloc(4*(gif->width/2)*gif->height);
+		conus->pixels[1] = g_malloc(4*(gif->width/2)*gif->height);
+		_conus_update_end_split_gif(gif, colors,
+				conus->pixels[0], conus->pixels[1]);
+		aweather_gif_free(gif);
+		g_debug("Conus: update_thread - decode %.1f ms, split %.1f ms",
+				(decoded - start) / 1000.0,
+				(g_get_monotonic_time() - decoded) / 1000.0);
+		goto out;
+	}
+	GError *error = NULL;
+	GdkPixbuf *pixbuf = gdk_pixbuf_new_from_file(conus->path, &error);
+	if (!pixbuf || error) {
+		g_warning("Conus: update_thread - error loading pixbuf: %s", conus->path);
+		conus->message = "Error loading pixbuf";
+		g_remove(conus->path);
+		g_clear_error(&error);
+		if (pixbuf)
+			g_object_unref(pixbuf);
+		goto out;
+	}
+	gint64 decoded = g_get_monotonic_time();
+
+	/* Split pixels into east/west parts */
+	guchar *pixels = gdk_pixbuf_get_pixels(pixbuf);
+	gint    width  = gdk_pixbuf_get_width(pixbuf);
+	gint    height = gdk_pixbuf_get_height(pixbuf);
+	gint    pxsize = gdk_pixbuf_get_has_alpha(pixbuf) ? 4 : 3;
+	conus->pixels[0] = g_malloc(4*(width/2)*height);
+	conus->pixels[1] = g_malloc(4*(width/2)*height);
+	_conus_update_end_split(pixels, conus->pixels[0], conus->pixels[1],
+			width, height, pxsize);
+	g_object_unref(pixbuf);
+	g_debug("Conus: update_thread - decode %.1f ms, split %.1f ms",
+			(decoded - start) / 1000.0,
+			(g_get_monotonic_time() - decoded) / 1000.0);
+
 out:
 	g_debug("Conus: update_thread - done");
 	if (!conus->idle_source)
@@ -565,8 +1654,13 @@ out:
 	return NULL;
 }
 
-void _conus_update(RadarConus *conus)
+static void _conus_update(RadarConus *conus)
 {
+	/* The loop moves to the new time instead */
+	if (conus->looping) {
+		_conus_loop_load(conus);
+		return;
+	}
 	if (!g_mutex_trylock(&conus->loading))
 		return;
 	conus->time = grits_viewer_get_time(conus->viewer);
@@ -582,13 +1676,21 @@ void _conus_update(RadarConus *conus)
 }
 
 RadarConus *radar_conus_new(GtkWidget *pconfig,
-		GritsViewer *viewer, GritsHttp *http)
+		GritsViewer *viewer, GritsPrefs *prefs, GritsHttp *http)
 {
 	RadarConus *conus = g_new0(RadarConus, 1);
 	conus->viewer  = g_object_ref(viewer);
+	conus->prefs   = g_object_ref(prefs);
 	conus->http    = http;
 	conus->config  = gtk_alignment_new(0, 0, 1, 1);
+	conus->loop_http = grits_http_new(G_DIR_SEPARATOR_S
+			"nexrad" G_DIR_SEPARATOR_S
+			"conus"  G_DIR_SEPARATOR_S);
 	g_mutex_init(&conus->loading);
+	g_mutex_init(&conus->loop_loading);
+	g_mutex_init(&conus->loop_lock);
+	conus->loop_pool = g_thread_pool_new(_conus_loop_expand, conus,
+			1, FALSE, NULL);
 
 	gdouble south =  CONUS_NORTH - CONUS_DEG_PER_PX*CONUS_HEIGHT;
 	gdouble east  =  CONUS_WEST  + CONUS_DEG_PER_PX*CONUS_WIDTH;
@@ -620,10 +1722,30 @@ void radar_conus_free(RadarConus *conus)
 	if (conus->idle_source)
 		g_source_remove(conus->idle_source);
 
-	for (int i = 0; i < 2; i++)
+	/* Wait for the loop thread */
+	if (conus->play_id)
+		g_source_remove(conus->play_id);
+	g_mutex_lock(&conus->loop_lock);
+	conus->looping = FALSE;
+	g_mutex_unlock(&conus->loop_lock);
+	grits_http_abort(conus->loop_http);
+	g_mutex_lock(&conus->loop_loading);
+	g_mutex_unlock(&conus->loop_loading);
+	g_thread_pool_free(conus->loop_pool, TRUE, TRUE);
+	_conus_loop_keep(conus, NULL);
+	grits_http_free(conus->loop_http);
+	g_free(conus->loop_name);
+
+	for (int i = 0; i < 2; i++) {
 		grits_object_destroy_pointer(&conus->tile[i]);
+		g_free(conus->pixels[i]);
+		g_free(conus->loop_pixels[i]);
+		g_free(conus->uploaded[i]);
+	}
+	g_free(conus->path);
 
 	g_object_unref(conus->viewer);
+	g_object_unref(conus->prefs);
 	g_free(conus);
 }
 
@@ -631,41 +1753,72 @@ void radar_conus_free(RadarConus *conus)
 /********************
  * GritsPluginRadar *
  ********************/
+/* Color table for the HUD, a one pixel wide texture that is made the first
+ * time the colormap is shown and made again if the colormap is reloaded */
+typedef struct {
+	guint    tex;
+	gdouble  coords[2];
+	gpointer data;      // Colors the texture was made from
+} RadarLegend;
+
+static void _legend_free(RadarLegend *legend)
+{
+	if (legend->tex)
+		glDeleteTextures(1, &legend->tex);
+	g_free(legend);
+}
+
+static RadarLegend *_legend_get(GritsPluginRadar *self, AWeatherColormap *colormap)
+{
+	RadarLegend *legend = g_hash_table_lookup(self->legends, colormap);
+	if (!legend) {
+		legend = g_new0(RadarLegend, 1);
+		g_hash_table_insert(self->legends, colormap, legend);
+	}
+	if (legend->data != colormap->data) {
+		g_debug("GritsPluginRadar: _legend_get - %s", colormap->file);
+		aweather_level2_load_tex(&legend->tex, legend->coords,
+				(guint8*)colormap->data, 1, colormap->len);
+		legend->data = colormap->data;
+	}
+	return legend;
+}
+
 static void _draw_hud(GritsCallback *callback, GritsOpenGL *opengl, gpointer _self)
 {
 	g_debug("GritsPluginRadar: _draw_hud");
 	/* Setup OpenGL */
 	glMatrixMode(GL_MODELVIEW ); glLoadIdentity();
 	glMatrixMode(GL_PROJECTION); glLoadIdentity();
-	glDisable(GL_TEXTURE_2D);
 	glDisable(GL_ALPHA_TEST);
 	glDisable(GL_CULL_FACE);
 	glDisable(GL_LIGHTING);
 	glEnable(GL_COLOR_MATERIAL);
+	glEnable(GL_TEXTURE_2D);
+	glColor4ub(255, 255, 255, 255);
 
-	GHashTableIter iter;
-	gpointer name, _site;
 	GritsPluginRadar *self = GRITS_PLUGIN_RADAR(_self);
-	g_hash_table_iter_init(&iter, self->sites);
-	while (g_hash_table_iter_next(&iter, &name, &_site)) {
+	for (GList *cur = self->visible; cur; cur = cur->next) {
 		/* Pick correct colormaps */
-		RadarSite *site = _site;
-		if (site->hidden || !site->level2)
+		RadarSite *site = cur->data;
+		if (!site->level2 || !site->level2->sweep_colors)
 			continue;
 		AWeatherColormap *colormap = site->level2->sweep_colors;
+		RadarLegend      *legend   = _legend_get(self, colormap);
 
-		/* Print the color table */
+		/* Print the color table, one row of the texture per color */
+		int     len = colormap->len;
+		gdouble s   = legend->coords[0] / 2;
+		gdouble t   = legend->coords[1];
+		glBindTexture(GL_TEXTURE_2D, legend->tex);
 		glBegin(GL_QUADS);
-		int len = colormap->len;
-		for (int i = 0; i < len; i++) {
-			glColor4ubv(colormap->data[i]);
-			glVertex3f(-1.0, (float)((i  ) - len/2)/(len/2), 0.0); // bot left
-			glVertex3f(-1.0, (float)((i+1) - len/2)/(len/2), 0.0); // top left
-			glVertex3f(-0.9, (float)((i+1) - len/2)/(len/2), 0.0); // top right
-			glVertex3f(-0.9, (float)((i  ) - len/2)/(len/2), 0.0); // bot right
-		}
+		glTexCoord2f(s, 0); glVertex3f(-1.0, (float)(  0 - len/2)/(len/2), 0.0); // bot left
+		glTexCoord2f(s, t); glVertex3f(-1.0, (float)(len - len/2)/(len/2), 0.0); // top left
+		glTexCoord2f(s, t); glVertex3f(-0.9, (float)(len - len/2)/(len/2), 0.0); // top right
+		glTexCoord2f(s, 0); glVertex3f(-0.9, (float)(  0 - len/2)/(len/2), 0.0); // bot right
 		glEnd();
 	}
+	glDisable(GL_TEXTURE_2D);
 }
 
 static void _load_colormap(gchar *filename, AWeatherColormap *cm)
@@ -695,30 +1848,265 @@ out:
 }
 
 static void _update_hidden(GtkNotebook *notebook,
-		gpointer _, guint page_num, gpointer viewer)
+		gpointer _, guint page_num, gpointer _self)
 {
+	GritsPluginRadar *self = GRITS_PLUGIN_RADAR(_self);
 	g_debug("GritsPluginRadar: _update_hidden - 0..%d = %d",
 			gtk_notebook_get_n_pages(notebook), page_num);
 
+	g_list_free(self->visible);
+	self->visible = NULL;
 	for (gint i = 0; i < gtk_notebook_get_n_pages(notebook); i++) {
 		gboolean is_hidden = (i != page_num);
 		GtkWidget  *config = gtk_notebook_get_nth_page(notebook, i);
 		RadarConus *conus  = g_object_get_data(G_OBJECT(config), "conus");
 		RadarSite  *site   = g_object_get_data(G_OBJECT(config), "site");
+		AWeatherMosaic *mosaic = g_object_get_data(G_OBJECT(config), "mosaic");
 
 		/* Conus */
 		if (conus) {
 			grits_object_hide(GRITS_OBJECT(conus->tile[0]), is_hidden);
 			grits_object_hide(GRITS_OBJECT(conus->tile[1]), is_hidden);
+		} else if (mosaic) {
+			aweather_mosaic_hide(mosaic, is_hidden);
 		} else if (site) {
 			site->hidden = is_hidden;
+			if (!is_hidden)
+				self->visible = g_list_prepend(self->visible, site);
 			if (site->level2)
-				grits_object_hide(GRITS_OBJECT(site->level2), is_hidden);
+				grits_object_hide(GRITS_OBJECT(site->level2),
+						is_hidden || site->anim != NULL);
+			if (site->anim)
+				grits_object_hide(GRITS_OBJECT(site->anim), is_hidden);
 		} else {
 			g_warning("GritsPluginRadar: _update_hidden - no site or counus found");
 		}
 	}
-	grits_viewer_queue_draw(viewer);
+	grits_viewer_queue_draw(self->viewer);
+}
+
+/* K-d tree over the site positions, stored in an array where the median of
+ * each range is the node and the halves on either side are its children */
+static gint _sites_cmp(gconstpointer a, gconstpointer b, gpointer _axis)
+{
+	gint axis = GPOINTER_TO_INT(_axis);
+	gdouble pa = (*(RadarSite**)a)->xyz[axis];
+	gdouble pb = (*(RadarSite**)b)->xyz[axis];
+	return pa < pb ? -1 : pa > pb ? 1 : 0;
+}
+
+static void _sites_build(RadarSite **sites, gint n, gint axis)
+{
+	if (n <= 1)
+		return;
+	g_qsort_with_data(sites, n, sizeof(RadarSite*),
+			_sites_cmp, GINT_TO_POINTER(axis));
+	_sites_build(sites,       n/2,     (axis+1)%3);
+	_sites_build(sites+n/2+1, n-n/2-1, (axis+1)%3);
+}
+
+static void _sites_find(RadarSite **sites, gint n, gint axis,
+		gdouble xyz[3], gdouble radius, GPtrArray *found)
+{
+	if (n <= 0)
+		return;
+	RadarSite *site = sites[n/2];
+	gdouble    diff = xyz[axis] - site->xyz[axis];
+	if (distd(site->xyz, xyz) <= radius)
+		g_ptr_array_add(found, site);
+	if (diff - radius <= 0)
+		_sites_find(sites, n/2, (axis+1)%3, xyz, radius, found);
+	if (diff + radius >= 0)
+		_sites_find(sites+n/2+1, n-n/2-1, (axis+1)%3, xyz, radius, found);
+}
+
+/* Prefetching, sites the camera is heading towards are downloaded (and
+ * optionally decoded) into the cache before they are loaded. This runs on
+ * a single thread and pauses after each volume to limit the bandwidth. */
+#define PREFETCH_AHEAD 5.0 // Seconds of camera motion to look ahead
+#define PREFETCH_QUEUE 4   // Most sites waiting to be prefetched
+
+static void _prefetch_thread(gpointer _site, gpointer _self)
+{
+	RadarSite        *site = _site;
+	GritsPluginRadar *self = _self;
+	if (grits_viewer_get_offline(self->viewer))
+		return;
+	g_mutex_lock(&prefetch_lock);
+	gboolean start = site->status == STATUS_UNLOADED && !self->prefetch_stop;
+	site->prefetching = start;
+	g_mutex_unlock(&prefetch_lock);
+	if (!start)
+		return;
+	g_debug("GritsPluginRadar: prefetch - %s", site->city->code);
+	gint     rate       = grits_prefs_get_integer(self->prefs, "aweather/prefetch_rate",  NULL);
+	gboolean parse      = grits_prefs_get_boolean(self->prefs, "aweather/prefetch_parse", NULL);
+	gchar   *nexrad_url = grits_prefs_get_string (self->prefs, "aweather/nexrad_url",     NULL);
+	gchar   *file       = NULL;
+
+	/* Find the volume the site would load, the site's listing is only
+	 * used by its update which waits for this to finish */
+	GritsHttp *http = radar_http_lease(self->sites_http, &site->prefetch_http);
+	if (!http)
+		goto done;
+	_site_list(site, http, nexrad_url, FALSE);
+	gint found = radar_times_nearest(site->times, site->prefetch);
+
+	/* Fetch it */
+	if (found >= 0) {
+		gchar *local = g_strconcat(site->city->code, "/",
+				site->times->files[found].name, NULL);
+		gchar *uri   = g_strconcat(nexrad_url, "/", local, NULL);
+		file = grits_http_fetch(http, uri, local,
+				GRITS_ONCE, NULL, NULL);
+		g_free(local);
+		g_free(uri);
+	}
+
+done:
+	/* Let an update of the site go ahead, decompressing and parsing
+	 * write through temporary files so they can overlap with it */
+	radar_http_release(self->sites_http, &site->prefetch_http);
+	g_mutex_lock(&prefetch_lock);
+	site->prefetching = FALSE;
+	g_cond_broadcast(&prefetch_cond);
+	g_mutex_unlock(&prefetch_lock);
+	if (file && parse) {
+		AWeatherStore *store = aweather_level2_load(file, site->city->code);
+		if (store)
+			aweather_store_free(store);
+	} else if (file) {
+		g_free(aweather_level2_decompress(file));
+	}
+
+	/* Keep the average rate down, dispose wakes this up early */
+	struct stat info;
+	if (file && rate > 0 && g_stat(file, &info) == 0) {
+		gint64 end = g_get_monotonic_time() +
+			info.st_size * G_USEC_PER_SEC / ((gint64)rate*1024);
+		g_mutex_lock(&prefetch_lock);
+		while (!self->prefetch_stop &&
+		       g_cond_wait_until(&prefetch_cond, &prefetch_lock, end));
+		g_mutex_unlock(&prefetch_lock);
+	}
+	g_free(nexrad_url);
+	g_free(file);
+}
+
+/* Estimate how the camera is moving and queue sites it will reach soon */
+static void _prefetch_update(GritsPluginRadar *self, gdouble eye[3], gdouble elev)
+{
+	gint64  now = g_get_monotonic_time();
+	gdouble dt  = (now - self->eye_time) / (gdouble)G_USEC_PER_SEC;
+	for (gint i = 0; i < 3; i++) {
+		gdouble speed = dt > 0 && dt < 1 ? (eye[i] - self->eye[i]) / dt : 0;
+		self->eye_speed[i] = (self->eye_speed[i] + speed) / 2;
+		self->eye[i] = eye[i];
+	}
+	self->eye_time = now;
+	if (!self->prefetch_pool)
+		return;
+
+	gdouble ahead[3];
+	for (gint i = 0; i < 3; i++)
+		ahead[i] = eye[i] + self->eye_speed[i]*PREFETCH_AHEAD;
+	if (distd(ahead, eye) < SITE_LOAD_DIST/10)
+		return;
+
+	time_t     time  = grits_viewer_get_time(self->viewer);
+	GPtrArray *found = g_ptr_array_new();
+	_sites_find(self->site_tree, self->nsites, 0,
+			ahead, SITE_LOAD_DIST, found);
+	for (guint i = 0; i < found->len; i++) {
+		RadarSite *site = g_ptr_array_index(found, i);
+		if (site->status != STATUS_UNLOADED || site->prefetch == time)
+			continue;
+		if (distd(site->xyz, ahead) >= elev*1.25)
+			continue;
+		if (g_thread_pool_unprocessed(self->prefetch_pool) >= PREFETCH_QUEUE)
+			break;
+		site->prefetch = time;
+		g_thread_pool_push(self->prefetch_pool, site, NULL);
+	}
+	g_ptr_array_free(found, TRUE);
+}
+
+/* Only sites within the unload distance now, or last time, are checked */
+static void _on_location_changed(GritsViewer *viewer,
+		gdouble lat, gdouble lon, gdouble elev,
+		GritsPluginRadar *self)
+{
+	gdouble eye[3];
+	lle2xyz(lat, lon, elev, &eye[0], &eye[1], &eye[2]);
+	GPtrArray *found = g_ptr_array_new();
+	_sites_find(self->site_tree, self->nsites, 0,
+			eye, 2*SITE_LOAD_DIST, found);
+
+	self->stamp++;
+	for (guint i = 0; i < found->len; i++) {
+		RadarSite *site = g_ptr_array_index(found, i);
+		site->stamp = self->stamp;
+	}
+	for (guint i = 0; i < self->near->len; i++) {
+		RadarSite *site = g_ptr_array_index(self->near, i);
+		if (site->stamp != self->stamp)
+			_site_set_distance(site, distd(site->xyz, eye), elev);
+	}
+	for (guint i = 0; i < found->len; i++) {
+		RadarSite *site = g_ptr_array_index(found, i);
+		_site_set_distance(site, distd(site->xyz, eye), elev);
+	}
+	g_ptr_array_free(self->near, TRUE);
+	self->near = found;
+	_prefetch_update(self, eye, elev);
+}
+
+/* Mosaic of the lowest tilt from every loaded site */
+static void _mosaic_toggled(GtkToggleButton *button, gpointer _self)
+{
+	GritsPluginRadar *self = _self;
+	if (!gtk_toggle_button_get_active(button))
+		return;
+	gboolean max = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(button), "max"));
+	grits_prefs_set_string(self->prefs, "aweather/mosaic_mode",
+			max ? "max" : "nearest");
+	aweather_mosaic_set_mode(self->mosaic, max ? MOSAIC_MAX : MOSAIC_NEAREST);
+}
+
+static AWeatherMosaic *_mosaic_new(GritsPluginRadar *self)
+{
+	AWeatherColormap *colormap = &colormaps[0];
+	for (int i = 0; colormaps[i].file; i++)
+		if (colormaps[i].type == DZ_INDEX)
+			colormap = &colormaps[i];
+	AWeatherMosaic *mosaic = aweather_mosaic_new(self->viewer, colormap);
+
+	gchar   *mode = grits_prefs_get_string(self->prefs, "aweather/mosaic_mode", NULL);
+	gboolean max  = g_strcmp0(mode, "max") == 0;
+	aweather_mosaic_set_mode(mosaic, max ? MOSAIC_MAX : MOSAIC_NEAREST);
+	g_free(mode);
+
+	/* Add tab page */
+	GtkWidget *box     = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
+	GtkWidget *label   = gtk_label_new("Composite:");
+	GtkWidget *nearest = gtk_radio_button_new_with_label(NULL, "Nearest");
+	GtkWidget *maximum = gtk_radio_button_new_with_label_from_widget(
+			GTK_RADIO_BUTTON(nearest), "Maximum");
+	g_object_set_data(G_OBJECT(maximum), "max", GINT_TO_POINTER(TRUE));
+	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(max ? maximum : nearest), TRUE);
+	g_signal_connect(nearest, "toggled", G_CALLBACK(_mosaic_toggled), self);
+	g_signal_connect(maximum, "toggled", G_CALLBACK(_mosaic_toggled), self);
+	gtk_box_pack_start(GTK_BOX(box), label,   FALSE, FALSE, 5);
+	gtk_box_pack_start(GTK_BOX(box), nearest, FALSE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(box), maximum, FALSE, FALSE, 0);
+
+	GtkWidget *config = gtk_alignment_new(0, 0, 1, 1);
+	gtk_container_add(GTK_CONTAINER(config), box);
+	g_object_set_data(G_OBJECT(config), "mosaic", mosaic);
+	gtk_notebook_append_page(GTK_NOTEBOOK(self->config), config,
+			gtk_label_new("Mosaic"));
+	gtk_widget_show_all(config);
+	return mosaic;
 }
 
 /* Methods */
@@ -732,24 +2120,54 @@ GritsPluginRadar *grits_plugin_radar_new(GritsViewer *viewer, GritsPrefs *prefs)
 
 	/* Setup page switching */
 	self->tab_id = g_signal_connect(self->config, "switch-page",
-			G_CALLBACK(_update_hidden), viewer);
+			G_CALLBACK(_update_hidden), self);
 
 	/* Load HUD */
 	self->hud = grits_callback_new(_draw_hud, self);
 	grits_viewer_add(viewer, GRITS_OBJECT(self->hud), GRITS_LEVEL_HUD, FALSE);
 
 	/* Load Conus */
-	self->conus = radar_conus_new(self->config, self->viewer, self->conus_http);
-
-	/* Load radar sites */
+	self->conus = radar_conus_new(self->config, self->viewer, self->prefs,
+			self->conus_http);
+
+	/* Load Mosaic */
+	self->mosaic = _mosaic_new(self);
+
+	/* Load radar sites, updates share a few threads and http sessions */
+	gint sessions = grits_prefs_get_integer(prefs, "aweather/http_sessions", NULL);
+	self->sites_http = radar_http_new(sessions > 0 ? sessions : 4);
+	gint threads = grits_prefs_get_integer(prefs, "aweather/update_threads", NULL);
+	self->sites_pool = g_thread_pool_new(_site_update_thread, NULL,
+			threads > 0 ? threads : 2, FALSE, NULL);
 	for (city_t *city = cities; city->type; city++) {
 		if (city->type != LOCATION_CITY)
 			continue;
 		RadarSite *site = radar_site_new(city, self->config,
-				self->viewer, self->prefs, self->sites_http);
+				self->viewer, self->prefs, self->sites_http,
+				self->mosaic, self->sites_pool);
 		g_hash_table_insert(self->sites, city->code, site);
 	}
 
+	/* Prefetch sites on a low priority thread */
+	if (grits_prefs_get_integer(prefs, "aweather/prefetch_rate", NULL) > 0)
+		self->prefetch_pool = g_thread_pool_new(_prefetch_thread, self,
+				1, FALSE, NULL);
+
+	/* Index sites by position for loading and unloading */
+	GHashTableIter iter;
+	gpointer name, site;
+	self->site_tree = g_new(RadarSite*, g_hash_table_size(self->sites));
+	g_hash_table_iter_init(&iter, self->sites);
+	while (g_hash_table_iter_next(&iter, &name, &site))
+		self->site_tree[self->nsites++] = site;
+	_sites_build(self->site_tree, self->nsites, 0);
+	self->near = g_ptr_array_new();
+	self->location_id = g_signal_connect(viewer, "location-changed",
+			G_CALLBACK(_on_location_changed), self);
+	gdouble lat, lon, elev;
+	grits_viewer_get_location(viewer, &lat, &lon, &elev);
+	_on_location_changed(viewer, lat, lon, elev, self);
+
 	return self;
 }
 
@@ -774,14 +2192,14 @@ static void grits_plugin_radar_init(GritsPluginRadar *self)
 {
 	g_debug("GritsPluginRadar: class_init");
 	/* Set defaults */
-	self->sites_http = grits_http_new(G_DIR_SEPARATOR_S
-			"nexrad" G_DIR_SEPARATOR_S
-			"level2" G_DIR_SEPARATOR_S);
 	self->conus_http = grits_http_new(G_DIR_SEPARATOR_S
 			"nexrad" G_DIR_SEPARATOR_S
 			"conus"  G_DIR_SEPARATOR_S);
+
 	self->sites      = g_hash_table_new_full(g_str_hash, g_str_equal,
 				NULL, (GDestroyNotify)radar_site_free);
+	self->legends    = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+				NULL, (GDestroyNotify)_legend_free);
 	self->config     = g_object_ref(gtk_notebook_new());
 
 	/* Load colormaps */
@@ -803,9 +2221,35 @@ static void grits_plugin_radar_dispose(GObject *gobject)
 		GritsViewer *viewer = self->viewer;
 		self->viewer = NULL;
 		g_signal_handler_disconnect(self->config, self->tab_id);
+		g_signal_handler_disconnect(viewer, self->location_id);
 		grits_object_destroy_pointer(&self->hud);
 		radar_conus_free(self->conus);
+
+		/* Stop updates before freeing the sites */
+		GHashTableIter iter;
+		gpointer name, site;
+		g_hash_table_iter_init(&iter, self->sites);
+		while (g_hash_table_iter_next(&iter, &name, &site))
+			_site_cancel(site);
+		g_thread_pool_free(self->sites_pool, TRUE, TRUE);
+		if (self->prefetch_pool) {
+			g_mutex_lock(&prefetch_lock);
+			self->prefetch_stop = TRUE;
+			g_cond_broadcast(&prefetch_cond);
+			g_mutex_unlock(&prefetch_lock);
+			g_hash_table_iter_init(&iter, self->sites);
+			while (g_hash_table_iter_next(&iter, &name, &site))
+				radar_http_abort(self->sites_http,
+						&((RadarSite*)site)->prefetch_http);
+			g_thread_pool_free(self->prefetch_pool, TRUE, TRUE);
+		}
+		g_ptr_array_free(self->near, TRUE);
+		g_free(self->site_tree);
+		g_list_free(self->visible);
+		self->visible = NULL;
 		g_hash_table_destroy(self->sites);
+		g_hash_table_destroy(self->legends);
+		aweather_mosaic_free(self->mosaic);
 		g_object_unref(self->config);
 		g_object_unref(self->prefs);
 		g_object_unref(viewer);
@@ -819,7 +2263,8 @@ static void grits_plugin_radar_finalize(GObject *gobject)
 	GritsPluginRadar *self = GRITS_PLUGIN_RADAR(gobject);
 	/* Free data */
 	grits_http_free(self->conus_http);
-	grits_http_free(self->sites_http);
+	if (self->sites_http)
+		radar_http_free(self->sites_http);
 	gtk_widget_destroy(self->config);
 	G_OBJECT_CLASS(grits_plugin_radar_parent_class)->finalize(gobject);
 
@@ -24,6 +24,7 @@
 #include <grits.h>
 #include "radar-info.h"
 #include "level2.h"
+#include "mosaic.h"
 
 #define GRITS_TYPE_PLUGIN_RADAR            (grits_plugin_radar_get_type ())
 #define GRITS_PLUGIN_RADAR(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj),   GRITS_TYPE_PLUGIN_RADAR, GritsPluginRadar))
@@ -37,6 +38,7 @@ typedef struct _GritsPluginRadarClass GritsPluginRadarClass;
 
 typedef struct _RadarConus RadarConus;
 typedef struct _RadarSite  RadarSite;
+typedef struct _RadarHttp  RadarHttp;
 
 struct _GritsPluginRadar {
 	GObject parent_instance;
@@ -48,12 +50,28 @@ struct _GritsPluginRadar {
 	guint        tab_id;
 	AWeatherColormap *colormap;
 	GritsCallback    *hud;
+	GHashTable       *legends; // Colormap -> RadarLegend, drawn on the HUD
+	GList            *visible; // Sites whose tab is shown
 
 	GHashTable  *sites;
-	GritsHttp   *sites_http;
+	RadarHttp   *sites_http;
+	GThreadPool *sites_pool;
+	RadarSite  **site_tree;  // K-d tree over site positions
+	gint         nsites;
+	GPtrArray   *near;       // Sites in range at the last location change
+	guint        stamp;
+	guint        location_id;
+
+	GThreadPool *prefetch_pool;
+	gboolean     prefetch_stop; // Set by dispose, under prefetch_lock
+	gdouble      eye[3];       // Camera position at the last location change
+	gdouble      eye_speed[3]; // Smoothed camera velocity, m/s
+	gint64       eye_time;
 
 	RadarConus  *conus;
 	GritsHttp   *conus_http;
+
+	AWeatherMosaic *mosaic;
 };
 
 struct _GritsPluginRadarClass {
@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2009-2012 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <math.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <grits.h>
+#include <rsl.h>
+
+#include "rain.h"
+#include "store.h"
+
+/* Z-R relationship, Z = A * R^B (WSR-88D default) */
+#define RAIN_ZR_A   300.0
+#define RAIN_ZR_B   1.4
+#define RAIN_MINDBZ 10.0  // Treat weaker echos as no rain
+#define RAIN_MAXDBZ 53.0  // Stronger echos are likely hail, cap them
+
+#define RAIN_NDATA  (1 + RAIN_PERIODS + RAIN_BUCKETS)
+#define RAIN_MAGIC  "AWRAIN1"
+
+/* Checkpoint file header, followed by RAIN_NDATA grids of floats */
+typedef struct {
+	gchar   magic[8];
+	guint32 cells;
+	guint32 ndata;
+	gint64  time;
+	gint64  start;
+	gint64  bucket_time[RAIN_BUCKETS];
+	guint8  bucket_1hr[RAIN_BUCKETS];
+} RainHeader;
+
+/* Accumulations are stored in hundredths of a millimeter */
+#define RAIN_GAIN   0.01
+#define RAIN_OFFSET (-CODE_MIN*RAIN_GAIN)
+static guint RAIN_CODE(float x)
+{
+	return MIN(x / RAIN_GAIN + CODE_MIN + 0.5, G_MAXUINT16);
+}
+
+/* Convert the lowest sweep to rain rates on the accumulation grid */
+static gfloat *_rain_resample(AWeatherSweep *sweep)
+{
+	/* Rain rate for each half dBZ step */
+	gfloat lut[(gint)((RAIN_MAXDBZ-RAIN_MINDBZ)*2)+1];
+	for (gint i = 0; i < G_N_ELEMENTS(lut); i++) {
+		gdouble z = pow(10, (RAIN_MINDBZ + i/2.0)/10);
+		lut[i] = pow(z/RAIN_ZR_A, 1/RAIN_ZR_B);
+	}
+
+	gfloat  *rate  = g_new0(gfloat,  RAIN_CELLS);
+	guint16 *count = g_new0(guint16, RAIN_CELLS);
+	for (int ri = 0; ri < sweep->nrays; ri++) {
+		gint cr = (gint)fmod(sweep->azimuth[ri] + 360, 360) % RAIN_RAYS;
+		for (int bi = 0; bi < sweep->nbins; bi++) {
+			gint  cb    = (sweep->range_bin1 + bi*sweep->gate_size) / RAIN_GATE;
+			guint code  = aweather_sweep_code(sweep, ri, bi);
+			float value = aweather_sweep_value(sweep, code);
+			if (cb >= RAIN_BINS)
+				break;
+			/* No echo counts as no rain, other flags are missing data */
+			if (code < CODE_MIN && code != CODE_NOECHO)
+				continue;
+			gint i = cr*RAIN_BINS + cb;
+			if (code >= CODE_MIN && value >= RAIN_MINDBZ)
+				rate[i] += lut[(gint)((MIN(value, RAIN_MAXDBZ)-RAIN_MINDBZ)*2)];
+			count[i]++;
+		}
+	}
+	for (int i = 0; i < RAIN_CELLS; i++)
+		if (count[i])
+			rate[i] /= count[i];
+	g_free(count);
+	return rate;
+}
+
+static void _rain_sub(gfloat *sum, gfloat *bucket)
+{
+	for (int i = 0; i < RAIN_CELLS; i++)
+		sum[i] = MAX(sum[i] - bucket[i], 0);
+}
+
+/* Remove buckets that have aged out of the 1 and 3 hour windows */
+static void _rain_expire(AWeatherRain *rain, time_t now)
+{
+	for (int b = 0; b < RAIN_BUCKETS; b++) {
+		if (!rain->bucket_time[b])
+			continue;
+		gdouble age = difftime(now, rain->bucket_time[b]);
+		if (rain->bucket_1hr[b] && age >= 1*60*60) {
+			_rain_sub(rain->sum[RAIN_1HR], rain->bucket[b]);
+			rain->bucket_1hr[b] = FALSE;
+		}
+		if (age >= 3*60*60) {
+			_rain_sub(rain->sum[RAIN_3HR], rain->bucket[b]);
+			memset(rain->bucket[b], 0, RAIN_CELLS*sizeof(gfloat));
+			rain->bucket_time[b] = 0;
+		}
+	}
+}
+
+/* Find the bucket for a time, starting a new one if needed */
+static gint _rain_bucket(AWeatherRain *rain, time_t time)
+{
+	time_t start = time - time % RAIN_BUCKET;
+	gint   b     = (start / RAIN_BUCKET) % RAIN_BUCKETS;
+	if (rain->bucket_time[b] != start) {
+		memset(rain->bucket[b], 0, RAIN_CELLS*sizeof(gfloat));
+		rain->bucket_time[b] = start;
+		rain->bucket_1hr[b]  = TRUE;
+	}
+	return b;
+}
+
+/* Add the lowest reflectivity sweep of a volume to the accumulation,
+ * integrating the rain rate over the time since the last volume */
+gboolean aweather_rain_update(AWeatherRain *rain, AWeatherStore *store)
+{
+	AWeatherVolume *volume = aweather_store_volume(store, DZ_INDEX);
+	AWeatherSweep  *sweep  = volume ? aweather_volume_closest(volume, 0) : NULL;
+	time_t          time   = store->time;
+	if (!sweep || time <= rain->time)
+		return FALSE;
+
+	gfloat *rate = _rain_resample(sweep);
+
+	g_mutex_lock(&rain->lock);
+	gdouble dt = difftime(time, rain->time);
+	_rain_expire(rain, time);
+	if (rain->time && dt <= RAIN_MAXGAP) {
+		gint    b      = _rain_bucket(rain, time);
+		gfloat *bucket = rain->bucket[b];
+		gfloat *hr1    = rain->sum[RAIN_1HR];
+		gfloat *hr3    = rain->sum[RAIN_3HR];
+		gfloat *total  = rain->sum[RAIN_TOTAL];
+		gfloat  hours  = dt / (60*60);
+		if (!rain->start)
+			rain->start = rain->time;
+		for (int i = 0; i < RAIN_CELLS; i++) {
+			gfloat depth = (rain->rate[i] + rate[i]) / 2 * hours;
+			bucket[i] += depth;
+			hr1[i]    += depth;
+			hr3[i]    += depth;
+			total[i]  += depth;
+		}
+	}
+	memcpy(rain->rate, rate, RAIN_CELLS*sizeof(gfloat));
+	rain->time = time;
+	g_mutex_unlock(&rain->lock);
+
+	g_debug("AWeatherRain: update - dt=%.0f", dt);
+	g_free(rate);
+	return TRUE;
+}
+
+/* Checkpoint the accumulation to the cache */
+gboolean aweather_rain_save(AWeatherRain *rain)
+{
+	gsize   len = sizeof(RainHeader) + RAIN_NDATA*RAIN_CELLS*sizeof(gfloat);
+	guint8 *buf = g_malloc0(len);
+	RainHeader *header = (RainHeader*)buf;
+
+	g_mutex_lock(&rain->lock);
+	strcpy(header->magic, RAIN_MAGIC);
+	header->cells = RAIN_CELLS;
+	header->ndata = RAIN_NDATA;
+	header->time  = rain->time;
+	header->start = rain->start;
+	for (int b = 0; b < RAIN_BUCKETS; b++) {
+		header->bucket_time[b] = rain->bucket_time[b];
+		header->bucket_1hr[b]  = rain->bucket_1hr[b];
+	}
+	memcpy(buf+sizeof(RainHeader), rain->data,
+			RAIN_NDATA*RAIN_CELLS*sizeof(gfloat));
+	g_mutex_unlock(&rain->lock);
+
+	GError *error = NULL;
+	gchar  *dir   = g_path_get_dirname(rain->path);
+	g_mkdir_with_parents(dir, 0755);
+	g_file_set_contents(rain->path, (gchar*)buf, len, &error);
+	if (error) {
+		g_warning("AWeatherRain: save - %s", error->message);
+		g_error_free(error);
+	}
+	g_free(dir);
+	g_free(buf);
+	return error == NULL;
+}
+
+/* Restore a checkpoint, ignoring it if the layout has changed */
+static void _rain_load(AWeatherRain *rain)
+{
+	gchar *buf;
+	gsize  len;
+	if (!g_file_get_contents(rain->path, &buf, &len, NULL))
+		return;
+	RainHeader *header = (RainHeader*)buf;
+	if (len != sizeof(RainHeader) + RAIN_NDATA*RAIN_CELLS*sizeof(gfloat) ||
+	    strcmp(header->magic, RAIN_MAGIC) ||
+	    header->cells != RAIN_CELLS ||
+	    header->ndata != RAIN_NDATA) {
+		g_warning("AWeatherRain: load - invalid checkpoint %s", rain->path);
+		g_free(buf);
+		return;
+	}
+	rain->time  = header->time;
+	rain->start = header->start;
+	for (int b = 0; b < RAIN_BUCKETS; b++) {
+		rain->bucket_time[b] = header->bucket_time[b];
+		rain->bucket_1hr[b]  = header->bucket_1hr[b];
+	}
+	memcpy(rain->data, buf+sizeof(RainHeader),
+			RAIN_NDATA*RAIN_CELLS*sizeof(gfloat));
+	g_debug("AWeatherRain: load - %s", rain->path);
+	g_free(buf);
+}
+
+/* Clear the storm total, the windowed totals are left alone */
+void aweather_rain_reset(AWeatherRain *rain)
+{
+	g_mutex_lock(&rain->lock);
+	memset(rain->sum[RAIN_TOTAL], 0, RAIN_CELLS*sizeof(gfloat));
+	rain->start = 0;
+	g_mutex_unlock(&rain->lock);
+}
+
+/* Copy an accumulation to a new sweep so it can be drawn */
+AWeatherSweep *aweather_rain_sweep(AWeatherRain *rain, AWeatherRainPeriod period)
+{
+	AWeatherSweep *sweep = aweather_sweep_new(RN1_INDEX + period, RAIN_RAYS, RAIN_BINS, 2);
+	sweep->beam_width = 1;
+	sweep->range_bin1 = RAIN_GATE/2;
+	sweep->gate_size  = RAIN_GATE;
+	sweep->gain       = RAIN_GAIN;
+	sweep->offset     = RAIN_OFFSET;
+	for (int ri = 0; ri < RAIN_RAYS; ri++)
+		sweep->azimuth[ri] = ri + 0.5;
+	aweather_sweep_index(sweep);
+
+	g_mutex_lock(&rain->lock);
+	gfloat *sum = rain->sum[period];
+	for (int ri = 0; ri < RAIN_RAYS; ri++)
+	for (int bi = 0; bi < RAIN_BINS; bi++)
+		aweather_sweep_set(sweep, ri, bi, RAIN_CODE(sum[ri*RAIN_BINS + bi]));
+	g_mutex_unlock(&rain->lock);
+	return sweep;
+}
+
+AWeatherRain *aweather_rain_new(const gchar *site)
+{
+	AWeatherRain *rain = g_new0(AWeatherRain, 1);
+	g_mutex_init(&rain->lock);
+	rain->path = g_build_filename(g_get_user_cache_dir(), "grits",
+			"nexrad", "level2", site, "rain.acc", NULL);
+	rain->data = g_new0(gfloat, RAIN_NDATA*RAIN_CELLS);
+	rain->rate = rain->data;
+	for (int p = 0; p < RAIN_PERIODS; p++)
+		rain->sum[p] = rain->data + (1+p)*RAIN_CELLS;
+	for (int b = 0; b < RAIN_BUCKETS; b++)
+		rain->bucket[b] = rain->data + (1+RAIN_PERIODS+b)*RAIN_CELLS;
+	_rain_load(rain);
+	return rain;
+}
+
+void aweather_rain_free(AWeatherRain *rain)
+{
+	g_mutex_clear(&rain->lock);
+	g_free(rain->data);
+	g_free(rain->path);
+	g_free(rain);
+}
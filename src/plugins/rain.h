@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2009-2012 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __AWEATHER_RAIN_H__
+#define __AWEATHER_RAIN_H__
+
+#include <glib.h>
+#include "store.h"
+
+/* Polar grid the accumulation is kept on */
+#define RAIN_RAYS    360       // One degree rays
+#define RAIN_BINS    230       // Out to 230 km
+#define RAIN_GATE    1000.0    // One kilometer gates
+#define RAIN_CELLS   (RAIN_RAYS*RAIN_BINS)
+
+/* Windowed totals are summed from fixed length buckets, so the
+ * windows are only accurate to within one bucket */
+#define RAIN_BUCKET  (15*60)   // Length of each bucket, in seconds
+#define RAIN_BUCKETS 12        // Enough buckets to cover three hours
+#define RAIN_MAXGAP  (30*60)   // Don't integrate across longer gaps
+
+typedef enum {
+	RAIN_1HR,
+	RAIN_3HR,
+	RAIN_TOTAL,
+	RAIN_PERIODS,
+} AWeatherRainPeriod;
+
+typedef struct {
+	GMutex   lock;
+	gchar   *path;                      // Checkpoint file in the cache
+	time_t   time;                      // Time of the last volume added
+	time_t   start;                     // Start of the storm total
+	gfloat  *data;                      // Storage for everything below
+	gfloat  *rate;                      // Rain rate at time, mm/h
+	gfloat  *sum[RAIN_PERIODS];         // Running totals, mm
+	gfloat  *bucket[RAIN_BUCKETS];      // Total for each bucket, mm
+	time_t   bucket_time[RAIN_BUCKETS]; // Start of each bucket, 0 if unused
+	gboolean bucket_1hr[RAIN_BUCKETS];  // Bucket is still in the 1 hour sum
+} AWeatherRain;
+
+AWeatherRain *aweather_rain_new(const gchar *site);
+
+void aweather_rain_free(AWeatherRain *rain);
+
+gboolean aweather_rain_update(AWeatherRain *rain, AWeatherStore *store);
+
+gboolean aweather_rain_save(AWeatherRain *rain);
+
+void aweather_rain_reset(AWeatherRain *rain);
+
+AWeatherSweep *aweather_rain_sweep(AWeatherRain *rain, AWeatherRainPeriod period);
+
+#endif
@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2009-2012 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <math.h>
+#include <string.h>
+#include <grits.h>
+#include <rsl.h>
+
+#include "srv.h"
+#include "store.h"
+
+#define MOTION_MINDBZ  20.0 // Ignore weak echos when tracking
+#define MOTION_MINCORR 0.5  // Minimum correlation for a usable track
+
+/* The motion is tracked on the update threads while the main thread draws
+ * with it, the lock covers the motion vector and the flags */
+static GMutex motion_lock;
+
+/* Resample a sweep onto a cartesian grid, keeping the strongest
+ * echo that falls in each cell */
+static gfloat *_motion_echo(AWeatherSweep *sweep)
+{
+	gfloat *echo = g_new0(gfloat, MOTION_CELLS*MOTION_CELLS);
+	gdouble half = MOTION_CELLS*MOTION_CELL/2;
+	for (int ri = 0; ri < sweep->nrays; ri++) {
+		gdouble lx = sin(deg2rad(sweep->azimuth[ri]));
+		gdouble ly = cos(deg2rad(sweep->azimuth[ri]));
+		for (int bi = 0; bi < sweep->nbins; bi++) {
+			gdouble dist  = sweep->range_bin1 + bi*sweep->gate_size;
+			guint   code  = aweather_sweep_code(sweep, ri, bi);
+			float   value = aweather_sweep_value(sweep, code);
+			if (dist >= half)
+				break;
+			if (code < CODE_MIN || value < MOTION_MINDBZ)
+				continue;
+			gint x = (lx*dist + half) / MOTION_CELL;
+			gint y = (ly*dist + half) / MOTION_CELL;
+			gfloat *cell = &echo[y*MOTION_CELLS + x];
+			*cell = MAX(*cell, value - MOTION_MINDBZ);
+		}
+	}
+	return echo;
+}
+
+/* Find the shift from prev to cur with the best normalized cross
+ * correlation, refined to a fraction of a cell with a parabolic fit */
+static gboolean _motion_track(gfloat *prev, gfloat *cur, gint reach,
+		gdouble *dx, gdouble *dy)
+{
+	gint     size  = 2*reach+1;
+	gdouble *score = g_new0(gdouble, size*size);
+	gint     best  = 0;
+	for (gint sy = -reach; sy <= reach; sy++)
+	for (gint sx = -reach; sx <= reach; sx++) {
+		gdouble ab = 0, aa = 0, bb = 0;
+		for (gint y = MAX(0, -sy); y < MIN(MOTION_CELLS, MOTION_CELLS-sy); y++) {
+			gfloat *a = &prev[y*MOTION_CELLS];
+			gfloat *b = &cur[(y+sy)*MOTION_CELLS + sx];
+			for (gint x = MAX(0, -sx); x < MIN(MOTION_CELLS, MOTION_CELLS-sx); x++) {
+				ab += a[x]*b[x];
+				aa += a[x]*a[x];
+				bb += b[x]*b[x];
+			}
+		}
+		gint i = (sy+reach)*size + (sx+reach);
+		score[i] = aa > 0 && bb > 0 ? ab / sqrt(aa*bb) : 0;
+		if (score[i] > score[best])
+			best = i;
+	}
+
+	gint bx = best % size;
+	gint by = best / size;
+	*dx = bx - reach;
+	*dy = by - reach;
+	if (bx > 0 && bx < size-1) {
+		gdouble l = score[best-1], c = score[best], r = score[best+1];
+		if (l - 2*c + r < 0)
+			*dx += (l - r) / (2*(l - 2*c + r));
+	}
+	if (by > 0 && by < size-1) {
+		gdouble l = score[best-size], c = score[best], r = score[best+size];
+		if (l - 2*c + r < 0)
+			*dy += (l - r) / (2*(l - 2*c + r));
+	}
+
+	gboolean found = score[best] >= MOTION_MINCORR;
+	g_debug("AWeatherMotion: track - shift=%.2f,%.2f corr=%.2f",
+			*dx, *dy, score[best]);
+	g_free(score);
+	return found;
+}
+
+/* Track storm motion between the lowest reflectivity sweep of the
+ * previous volume and that of the new radar volume */
+void aweather_motion_update(AWeatherMotion *motion, AWeatherStore *store)
+{
+	AWeatherVolume *volume = aweather_store_volume(store, DZ_INDEX);
+	AWeatherSweep  *sweep  = volume ? aweather_volume_closest(volume, 0) : NULL;
+	if (!sweep)
+		return;
+
+	time_t  time = store->time;
+	gfloat *echo = _motion_echo(sweep);
+	gdouble dt   = difftime(time, motion->time);
+
+	g_mutex_lock(&motion_lock);
+	gboolean user = motion->user;
+	g_mutex_unlock(&motion_lock);
+
+	if (motion->echo && !user && dt > 0 && dt <= MOTION_MAXAGE) {
+		gint reach = MIN(MOTION_MAXSPD*dt/MOTION_CELL + 1, MOTION_CELLS/4);
+		gdouble dx, dy;
+		if (_motion_track(motion->echo, echo, reach, &dx, &dy)) {
+			g_mutex_lock(&motion_lock);
+			if (!motion->user) {
+				motion->u     = dx*MOTION_CELL/dt;
+				motion->v     = dy*MOTION_CELL/dt;
+				motion->valid = TRUE;
+			}
+			g_mutex_unlock(&motion_lock);
+			g_debug("AWeatherMotion: update - u=%.1f v=%.1f",
+					dx*MOTION_CELL/dt, dy*MOTION_CELL/dt);
+		}
+	}
+
+	g_free(motion->echo);
+	motion->echo = echo;
+	motion->time = time;
+}
+
+/* Set the motion from a heading (degrees clockwise from north) and speed */
+void aweather_motion_set(AWeatherMotion *motion, gfloat dir, gfloat speed)
+{
+	g_mutex_lock(&motion_lock);
+	motion->u     = speed * sin(deg2rad(dir));
+	motion->v     = speed * cos(deg2rad(dir));
+	motion->user  = TRUE;
+	motion->valid = TRUE;
+	g_mutex_unlock(&motion_lock);
+}
+
+/* Copy the motion vector, returns FALSE if it hasn't been set or tracked */
+gboolean aweather_motion_uv(AWeatherMotion *motion, gfloat *u, gfloat *v)
+{
+	g_mutex_lock(&motion_lock);
+	gboolean valid = motion->valid;
+	*u = motion->u;
+	*v = motion->v;
+	g_mutex_unlock(&motion_lock);
+	return valid;
+}
+
+gboolean aweather_motion_get(AWeatherMotion *motion, gfloat *dir, gfloat *speed)
+{
+	gfloat u, v;
+	gboolean valid = aweather_motion_uv(motion, &u, &v);
+	*speed = hypot(u, v);
+	*dir   = fmod(rad2deg(atan2(u, v)) + 360, 360);
+	return valid;
+}
+
+void aweather_motion_clear(AWeatherMotion *motion)
+{
+	g_mutex_lock(&motion_lock);
+	g_free(motion->echo);
+	memset(motion, 0, sizeof(AWeatherMotion));
+	g_mutex_unlock(&motion_lock);
+}
+
+/* Project the storm motion onto each ray of the sweep, the storm relative
+ * velocity of each gate is then just its radial velocity minus bias[ray].
+ * Returns FALSE, leaving bias alone, if there is no motion yet. */
+gboolean aweather_srv_bias(AWeatherMotion *motion, AWeatherSweep *sweep, gfloat *bias)
+{
+	gfloat u, v;
+	if (!aweather_motion_uv(motion, &u, &v))
+		return FALSE;
+	for (int ri = 0; ri < sweep->nrays; ri++)
+		bias[ri] = u * sin(deg2rad(sweep->azimuth[ri])) +
+		           v * cos(deg2rad(sweep->azimuth[ri]));
+	return TRUE;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2009-2012 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __AWEATHER_SRV_H__
+#define __AWEATHER_SRV_H__
+
+#include <glib.h>
+#include "store.h"
+
+/* Echo grid used for tracking, centered on the radar */
+#define MOTION_CELLS   128     // Width and height of the grid, in cells
+#define MOTION_CELL    2000.0  // Size of each cell, in meters
+#define MOTION_MAXSPD  40.0    // Fastest storm motion to search for, m/s
+#define MOTION_MAXAGE  (20*60) // Don't track across gaps longer than this
+
+/* Storm motion for a site, kept across volumes so that it can be tracked.
+ * The vector and flags are read with aweather_motion_uv or _get since the
+ * motion is tracked on another thread. */
+typedef struct {
+	gfloat   u, v;    // Storm motion, m/s towards the east and north
+	gboolean user;    // Motion was entered by the user, don't track it
+	gboolean valid;   // Motion has been set or tracked
+	time_t   time;    // Time of the volume the echo grid came from
+	gfloat  *echo;    // Lowest reflectivity sweep, MOTION_CELLS^2 grid
+} AWeatherMotion;
+
+void aweather_motion_update(AWeatherMotion *motion, AWeatherStore *store);
+
+void aweather_motion_set(AWeatherMotion *motion, gfloat dir, gfloat speed);
+
+gboolean aweather_motion_uv(AWeatherMotion *motion, gfloat *u, gfloat *v);
+
+gboolean aweather_motion_get(AWeatherMotion *motion, gfloat *dir, gfloat *speed);
+
+void aweather_motion_clear(AWeatherMotion *motion);
+
+gboolean aweather_srv_bias(AWeatherMotion *motion, AWeatherSweep *sweep, gfloat *bias);
+
+#endif
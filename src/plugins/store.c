@@ -0,0 +1,1170 @@
+/*
+ * Copyright (C) 2009-2012 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include <bzlib.h>
+#include <grits.h>
+#include <rsl.h>
+
+#include "store.h"
+
+/**********
+ * Sweeps *
+ **********/
+AWeatherSweep *aweather_sweep_new(gint type, gint nrays, gint nbins, gint depth)
+{
+	AWeatherSweep *sweep = g_new0(AWeatherSweep, 1);
+	sweep->type    = type;
+	sweep->nrays   = nrays;
+	sweep->nbins   = nbins;
+	sweep->depth   = depth;
+	sweep->azimuth = g_new0(gfloat, nrays);
+	sweep->elevs   = g_new0(gfloat, nrays);
+	sweep->codes   = g_malloc0((gsize)nrays*nbins*depth);
+	return sweep;
+}
+
+/* Build the azimuth index, once the ray azimuths are filled in */
+void aweather_sweep_index(AWeatherSweep *sweep)
+{
+	if (sweep->index)
+		radar_azindex_free(sweep->index);
+	sweep->index = radar_azindex_new(sweep->azimuth,
+			sweep->nrays, sweep->beam_width);
+}
+
+void aweather_sweep_free(AWeatherSweep *sweep)
+{
+	if (sweep->index)
+		radar_azindex_free(sweep->index);
+	if (!sweep->mapped) {
+		g_free(sweep->azimuth);
+		g_free(sweep->elevs);
+		g_free(sweep->codes);
+	}
+	g_free(sweep);
+}
+
+/* RSL stores each gate as a code where value = f(code). For the
+ * WSR-88D moments f is linear above the flags, so only the gain and
+ * offset need to be kept. */
+static gboolean _sweep_linear(Ray *ray, gfloat *gain, gfloat *offset)
+{
+	*gain   = ray->h.f(CODE_MIN+1) - ray->h.f(CODE_MIN);
+	*offset = ray->h.f(CODE_MIN)   - CODE_MIN * *gain;
+	return fabs(ray->h.f(1000) - (1000 * *gain + *offset)) < 0.001;
+}
+
+/* Flag codes for RSL's special values, these sort below CODE_MIN */
+static guint _sweep_flag(gfloat value)
+{
+	if (value == NOECHO) return CODE_NOECHO;
+	if (value == RFVAL)  return 1;
+	if (value == BADVAL || value == APFLAG || value != value ||
+	    value == NOTFOUND_H || value == NOTFOUND_V)
+		return 0;
+	return CODE_MIN;
+}
+
+/* Some moments don't map codes to values linearly, these are requantized
+ * into 16-bit codes spread evenly over the range of values RSL gives */
+static guint16 *_sweep_requantize(Ray *ray, Range max, gfloat *gain, gfloat *offset)
+{
+	gfloat *values = g_new(gfloat, max+1);
+	gfloat  vmin = G_MAXFLOAT, vmax = -G_MAXFLOAT;
+	for (guint code = CODE_MIN; code <= max; code++) {
+		values[code] = ray->h.f(code);
+		if (_sweep_flag(values[code]) < CODE_MIN)
+			continue;
+		vmin = MIN(vmin, values[code]);
+		vmax = MAX(vmax, values[code]);
+	}
+	*gain   = vmax > vmin ? (vmax - vmin) / (G_MAXUINT16 - CODE_MIN) : 1;
+	*offset = vmin - CODE_MIN * *gain;
+
+	guint16 *table = g_new(guint16, max+1);
+	for (guint code = 0; code <= max; code++) {
+		if (code < CODE_MIN)
+			table[code] = code;
+		else if (_sweep_flag(values[code]) < CODE_MIN)
+			table[code] = _sweep_flag(values[code]);
+		else
+			table[code] = CODE_MIN + lroundf((values[code] - vmin) / *gain);
+	}
+	g_free(values);
+	return table;
+}
+
+static AWeatherSweep *_sweep_new_rsl(Sweep *rsl, gint type)
+{
+	/* Find size, skipping missing rays */
+	Ray    *first = NULL;
+	gint    nrays = 0, nbins = 0;
+	Range   max   = 0;
+	for (gint ri = 0; ri < rsl->h.nrays; ri++) {
+		Ray *ray = rsl->ray[ri];
+		if (ray == NULL)
+			continue;
+		first = first ? first : ray;
+		nrays++;
+		nbins = MAX(nbins, ray->h.nbins);
+		for (gint bi = 0; bi < ray->h.nbins; bi++)
+			max = MAX(max, ray->range[bi]);
+	}
+	if (first == NULL)
+		return NULL;
+
+	gfloat   gain, offset;
+	guint16 *table = NULL;
+	if (!_sweep_linear(first, &gain, &offset)) {
+		g_debug("AWeatherStore: sweep - %d is not linear, requantizing", type);
+		table = _sweep_requantize(first, max, &gain, &offset);
+	}
+
+	AWeatherSweep *sweep = aweather_sweep_new(type, nrays, nbins,
+			max <= G_MAXUINT8 && !table ? 1 : 2);
+	sweep->elev       = rsl->h.elev;
+	sweep->beam_width = rsl->h.beam_width;
+	sweep->range_bin1 = first->h.range_bin1;
+	sweep->gate_size  = first->h.gate_size;
+	sweep->gain       = gain;
+	sweep->offset     = offset;
+
+	/* Copy rays, gates past the end of short rays are left as BADVAL */
+	for (gint ri = 0, si = 0; ri < rsl->h.nrays; ri++) {
+		Ray *ray = rsl->ray[ri];
+		if (ray == NULL)
+			continue;
+		sweep->azimuth[si] = ray->h.azimuth;
+		sweep->elevs[si]   = ray->h.elev;
+		for (gint bi = 0; bi < ray->h.nbins; bi++)
+			aweather_sweep_set(sweep, si, bi, table ?
+					table[ray->range[bi]] : ray->range[bi]);
+		si++;
+	}
+	aweather_sweep_index(sweep);
+	g_free(table);
+	return sweep;
+}
+
+
+/***********
+ * Volumes *
+ ***********/
+/* Moments stored in message 31 radials */
+static const struct {
+	gint   type;
+	gchar *field; // Name used by RSL_select_fields
+	gchar *block; // Name of the data block
+	gchar *name;
+} moments[] = {
+	{DZ_INDEX, "dz", "REF", "Reflectivity"},
+	{VR_INDEX, "vr", "VEL", "Velocity"},
+	{SW_INDEX, "sw", "SW ", "Spectrum Width"},
+	{DR_INDEX, "dr", "ZDR", "Differential Reflectivity"},
+	{PH_INDEX, "ph", "PHI", "Differential Phase"},
+	{RH_INDEX, "rh", "RHO", "Correlation Coefficient"},
+};
+
+static gint _moment(gint type)
+{
+	for (gint i = 0; i < G_N_ELEMENTS(moments); i++)
+		if (moments[i].type == type)
+			return i;
+	return -1;
+}
+
+AWeatherSweep *aweather_volume_closest(AWeatherVolume *volume, gfloat elev)
+{
+	AWeatherSweep *closest = NULL;
+	for (gint si = 0; si < volume->nsweeps; si++) {
+		AWeatherSweep *sweep = volume->sweep[si];
+		if (!closest || fabs(sweep->elev - elev) < fabs(closest->elev - elev))
+			closest = sweep;
+	}
+	return closest;
+}
+
+static AWeatherVolume *_volume_new(gint type, const gchar *name)
+{
+	gint m = _moment(type);
+	AWeatherVolume *volume = g_new0(AWeatherVolume, 1);
+	volume->type = type;
+	volume->name = g_strdup(m >= 0 ? moments[m].name : name);
+	return volume;
+}
+
+static void _volume_load_rsl(AWeatherVolume *volume, Volume *rsl)
+{
+	volume->sweep = g_new0(AWeatherSweep*, rsl->h.nsweeps);
+	for (gint si = 0; si < rsl->h.nsweeps; si++) {
+		if (rsl->sweep[si] == NULL)
+			continue;
+		AWeatherSweep *sweep = _sweep_new_rsl(rsl->sweep[si], volume->type);
+		if (sweep)
+			volume->sweep[volume->nsweeps++] = sweep;
+	}
+	if (volume->tilts == NULL) {
+		volume->ntilts = volume->nsweeps;
+		volume->tilts  = g_new0(gfloat, volume->nsweeps);
+		for (gint si = 0; si < volume->nsweeps; si++)
+			volume->tilts[si] = volume->sweep[si]->elev;
+	}
+	volume->loaded = TRUE;
+}
+
+static void _volume_free(AWeatherVolume *volume)
+{
+	for (gint si = 0; si < volume->nsweeps; si++)
+		aweather_sweep_free(volume->sweep[si]);
+	g_free(volume->sweep);
+	g_free(volume->tilts);
+	g_free(volume->name);
+	g_free(volume);
+}
+
+
+/***********
+ * Reading *
+ ***********/
+#define SCAN_CUTS 64 // Elevation numbers are 1 based
+
+static guint16 _be16(const guint8 *p) { return p[0]<<8 | p[1]; }
+static guint32 _be32(const guint8 *p) { return p[0]<<24 | p[1]<<16 | p[2]<<8 | p[3]; }
+static gfloat  _bef32(const guint8 *p)
+{
+	guint32 bits = _be32(p);
+	gfloat  value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+/* Read the target elevation angles from a VCP message (type 5) */
+static void _scan_vcp(const guint8 *vcp, gfloat angles[SCAN_CUTS])
+{
+	gint ncuts = _be16(vcp+6);
+	if (ncuts <= 0 || ncuts >= SCAN_CUTS || 22 + ncuts*46 > 2432-12-16)
+		return;
+	for (gint ci = 0; ci < ncuts; ci++) {
+		gfloat angle = _be16(vcp + 22 + ci*46) * 180.0 / 32768;
+		if (angle > -1 && angle < 90)
+			angles[ci+1] = angle;
+	}
+}
+
+/* Find the moments and tilts in a decompressed file by walking the message
+ * headers, none of the gate data is decoded. Only message 31 files (build
+ * 10 and later) can be scanned, FALSE is returned for older files. */
+static gboolean _scan(const gchar *file, AWeatherVolume *found[MAX_RADAR_VOLUMES])
+{
+	GMappedFile *map = g_mapped_file_new(file, FALSE, NULL);
+	if (!map)
+		return FALSE;
+	const guint8 *data = (guint8*)g_mapped_file_get_contents(map);
+	gsize         len  = g_mapped_file_get_length(map);
+
+	guint64 cuts[G_N_ELEMENTS(moments)] = {};
+	gfloat  angles[SCAN_CUTS] = {};
+	gdouble sum[SCAN_CUTS]    = {};
+	gint    count[SCAN_CUTS]  = {};
+	gint    nradials          = 0;
+
+	/* Each message has a 12 byte header left over from the old tape
+	 * format, message 31 is variable length and the rest are 2432 bytes */
+	for (gsize pos = 24; pos + 12+16 <= len;) {
+		const guint8 *msg  = data + pos + 12;
+		gsize         size = _be16(msg) * 2;
+		if (msg[3] != 31) {
+			if (msg[3] == 5 && pos + 2432 <= len)
+				_scan_vcp(msg+16, angles);
+			pos += 2432;
+			continue;
+		}
+		if (size < 16+68 || pos + 12+size > len)
+			break;
+
+		/* Radial header, block pointers are from the start of it */
+		const guint8 *radial = msg + 16;
+		gint          cut    = radial[22];
+		gint          nblock = MIN(_be16(radial+30), 9);
+		for (gint bi = 0; bi < nblock && cut > 0 && cut < SCAN_CUTS; bi++) {
+			guint32 ptr = _be32(radial + 32 + bi*4);
+			if (ptr == 0 || 16+ptr+4 > size)
+				continue;
+			for (gint m = 0; m < G_N_ELEMENTS(moments); m++)
+				if (radial[ptr] == 'D' &&
+				    !memcmp(radial+ptr+1, moments[m].block, 3))
+					cuts[m] |= (guint64)1 << cut;
+		}
+		if (cut > 0 && cut < SCAN_CUTS) {
+			sum[cut] += _bef32(radial+24);
+			count[cut]++;
+		}
+		nradials++;
+		pos += 12 + size;
+	}
+	g_mapped_file_unref(map);
+	g_debug("AWeatherStore: scan - %d radials", nradials);
+	if (nradials == 0)
+		return FALSE;
+
+	/* Tilts for each moment, sorted the same way as RSL_sort_radar */
+	for (gint m = 0; m < G_N_ELEMENTS(moments); m++) {
+		if (cuts[m] == 0)
+			continue;
+		AWeatherVolume *volume = _volume_new(moments[m].type, NULL);
+		volume->tilts = g_new0(gfloat, SCAN_CUTS);
+		for (gint cut = 1; cut < SCAN_CUTS; cut++) {
+			if (!(cuts[m] & ((guint64)1 << cut)))
+				continue;
+			gfloat angle = angles[cut] ? angles[cut] : sum[cut] / count[cut];
+			gint   ti    = volume->ntilts++;
+			for (; ti > 0 && volume->tilts[ti-1] > angle; ti--)
+				volume->tilts[ti] = volume->tilts[ti-1];
+			volume->tilts[ti] = angle;
+		}
+		found[moments[m].type] = volume;
+	}
+	return TRUE;
+}
+
+/* RSL keeps the selected fields in global state */
+static GMutex rsl_lock;
+
+static Radar *_read(const gchar *file, const gchar *site, const gchar *field)
+{
+	g_debug("AWeatherStore: read - %s %s", field, file);
+	g_mutex_lock(&rsl_lock);
+	RSL_read_these_sweeps("all", NULL);
+	RSL_select_fields((gchar*)field, NULL);
+	Radar *radar = RSL_wsr88d_to_radar((gchar*)file, (gchar*)site);
+	RSL_select_fields("all", NULL);
+	g_mutex_unlock(&rsl_lock);
+	if (radar)
+		RSL_sort_radar(radar);
+	g_debug("AWeatherStore: read - done");
+	return radar;
+}
+
+
+/**********
+ * Caches *
+ **********/
+/* Cache files hold the store in the same layout it has in memory so they
+ * can be mapped and the sweeps pointed into them. A header and a directory
+ * of sweeps come first, followed by the arrays for each sweep, so reading
+ * one sweep does not touch the rest of the file. Moments decoded later are
+ * appended with their own directory. Cache files are only meant to be read
+ * on the machine that wrote them. */
+#define CACHE_MAGIC    "AWSTORE"
+#define CACHE_VERSION  2
+#define CACHE_TILTS    64
+#define CACHE_ALIGN(n) (((guint64)(n) + 7) & ~(guint64)7)
+
+typedef struct {
+	gint32  present;
+	gint32  loaded;
+	gchar   name[48];
+	gint32  ntilts;
+	gfloat  tilts[CACHE_TILTS];
+	gint32  nsweeps;
+	gint32  pad;
+	guint64 dir;      // Offset of the volume's directory
+} CacheVolume;
+
+typedef struct {
+	gfloat  elev, beam_width, range_bin1, gate_size, gain, offset;
+	gint32  nrays, nbins, depth, pad;
+	guint64 azimuth;  // Offsets from the start of the file
+	guint64 elevs;
+	guint64 codes;
+} CacheSweep;
+
+typedef struct {
+	gchar       magic[8];
+	guint32     version;
+	guint32     pad;
+	gint64      size;     // Size and time of the source file
+	gint64      mtime;
+	gchar       site[8];
+	gint64      time;
+	gdouble     center[3];
+	CacheVolume volume[MAX_RADAR_VOLUMES];
+} CacheHeader;
+
+/* Cache files are shared by every store loaded from the same volume */
+static GMutex cache_lock;
+
+static gboolean _cache_stat(const gchar *source, gint64 *size, gint64 *mtime)
+{
+	struct stat st;
+	if (g_stat(source, &st) != 0)
+		return FALSE;
+	*size  = st.st_size;
+	*mtime = st.st_mtime;
+	return TRUE;
+}
+
+/* Write data followed by padding up to the alignment */
+static gboolean _cache_put(FILE *fd, gconstpointer data, gsize len)
+{
+	static const guint8 zero[8];
+	gsize pad = CACHE_ALIGN(len) - len;
+	return fwrite(data, 1, len, fd) == len &&
+	       fwrite(zero, 1, pad, fd) == pad;
+}
+
+/* Fill in the directory entries for a volume's sweeps, the arrays are
+ * placed one after another starting at pos */
+static guint64 _cache_dir(AWeatherVolume *volume, CacheSweep *dir, guint64 pos)
+{
+	for (gint si = 0; si < volume->nsweeps; si++) {
+		AWeatherSweep *sweep = volume->sweep[si];
+		dir[si] = (CacheSweep){
+			sweep->elev, sweep->beam_width, sweep->range_bin1,
+			sweep->gate_size, sweep->gain, sweep->offset,
+			sweep->nrays, sweep->nbins, sweep->depth};
+		dir[si].azimuth = pos; pos += CACHE_ALIGN(sweep->nrays*sizeof(gfloat));
+		dir[si].elevs   = pos; pos += CACHE_ALIGN(sweep->nrays*sizeof(gfloat));
+		dir[si].codes   = pos; pos += CACHE_ALIGN((gsize)sweep->nrays*sweep->nbins*sweep->depth);
+	}
+	return pos;
+}
+
+static gboolean _cache_arrays(FILE *fd, AWeatherVolume *volume)
+{
+	gboolean ok = TRUE;
+	for (gint si = 0; si < volume->nsweeps && ok; si++) {
+		AWeatherSweep *sweep = volume->sweep[si];
+		ok = _cache_put(fd, sweep->azimuth, sweep->nrays*sizeof(gfloat)) &&
+		     _cache_put(fd, sweep->elevs,   sweep->nrays*sizeof(gfloat)) &&
+		     _cache_put(fd, sweep->codes,
+				     (gsize)sweep->nrays*sweep->nbins*sweep->depth);
+	}
+	return ok;
+}
+
+static void _cache_volume(CacheVolume *cv, AWeatherVolume *volume, guint64 dir)
+{
+	cv->present = TRUE;
+	cv->loaded  = volume->loaded;
+	cv->ntilts  = MIN(volume->ntilts, CACHE_TILTS);
+	cv->nsweeps = volume->nsweeps;
+	cv->dir     = dir;
+	g_strlcpy(cv->name, volume->name, sizeof(cv->name));
+	memcpy(cv->tilts, volume->tilts, cv->ntilts*sizeof(gfloat));
+}
+
+static gboolean _cache_write(AWeatherStore *store)
+{
+	g_debug("AWeatherStore: cache_write - %s", store->cache);
+	CacheHeader header = {};
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = CACHE_VERSION;
+	if (!_cache_stat(store->source, &header.size, &header.mtime))
+		return FALSE;
+	memcpy(header.site, store->site, sizeof(header.site));
+	header.time      = store->time;
+	header.center[0] = store->center.lat;
+	header.center[1] = store->center.lon;
+	header.center[2] = store->center.elev;
+
+	/* Fill in the directory, arrays are placed after it */
+	gint nsweeps = 0;
+	for (gint vi = 0; vi < MAX_RADAR_VOLUMES; vi++)
+		if (store->volume[vi])
+			nsweeps += store->volume[vi]->nsweeps;
+	CacheSweep *dir   = g_new0(CacheSweep, nsweeps);
+	guint64     start = CACHE_ALIGN(sizeof(header));
+	guint64     pos   = start + CACHE_ALIGN(nsweeps*sizeof(CacheSweep));
+	for (gint vi = 0, di = 0; vi < MAX_RADAR_VOLUMES; vi++) {
+		AWeatherVolume *volume = store->volume[vi];
+		if (volume == NULL)
+			continue;
+		_cache_volume(&header.volume[vi], volume, start + di*sizeof(CacheSweep));
+		pos = _cache_dir(volume, &dir[di], pos);
+		di += volume->nsweeps;
+	}
+
+	/* Write to a new temporary file, mapped copies of the old file stay
+	 * valid and other writers of the same cache don't clobber it */
+	g_mutex_lock(&cache_lock);
+	gchar   *tmp = g_strconcat(store->cache, ".XXXXXX", NULL);
+	gint     fno = g_mkstemp(tmp);
+	FILE    *fd  = fno >= 0 ? fdopen(fno, "wb") : NULL;
+	if (fno >= 0 && fd == NULL)
+		close(fno);
+	gboolean ok  = fd != NULL &&
+		_cache_put(fd, &header, sizeof(header)) &&
+		_cache_put(fd, dir, nsweeps*sizeof(CacheSweep));
+	for (gint vi = 0; vi < MAX_RADAR_VOLUMES && ok; vi++)
+		if (store->volume[vi])
+			ok = _cache_arrays(fd, store->volume[vi]);
+	if (fd && fclose(fd) != 0)
+		ok = FALSE;
+	if (ok)
+		ok = g_rename(tmp, store->cache) == 0;
+	if (!ok) {
+		g_warning("AWeatherStore: cache_write - unable to write %s", store->cache);
+		if (fno >= 0)
+			g_remove(tmp);
+	}
+	g_mutex_unlock(&cache_lock);
+	g_free(tmp);
+	g_free(dir);
+	return ok;
+}
+
+/* Add a moment decoded after the cache was written. The directory and
+ * arrays go at the end of the file and the header is updated last, the
+ * sweeps already mapped from the file are left as they are. */
+static gboolean _cache_append(AWeatherStore *store, gint type)
+{
+	g_debug("AWeatherStore: cache_append - %d %s", type, store->cache);
+	AWeatherVolume *volume = store->volume[type];
+	CacheHeader     header;
+	gint64          size, mtime;
+
+	g_mutex_lock(&cache_lock);
+	FILE    *fd = g_fopen(store->cache, "r+b");
+	gboolean ok = fd != NULL &&
+		fread(&header, sizeof(header), 1, fd) == 1 &&
+		!memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) &&
+		header.version == CACHE_VERSION &&
+		_cache_stat(store->source, &size, &mtime) &&
+		header.size == size && header.mtime == mtime;
+	if (!ok) {
+		/* Missing or replaced, write the whole store instead */
+		if (fd)
+			fclose(fd);
+		g_mutex_unlock(&cache_lock);
+		return _cache_write(store);
+	}
+
+	/* Another store for the same volume may have added it already */
+	if (!header.volume[type].loaded) {
+		ok = fseek(fd, 0, SEEK_END) == 0;
+		guint64     pos = ok ? CACHE_ALIGN(ftell(fd)) : 0;
+		CacheSweep *dir = g_new0(CacheSweep, volume->nsweeps);
+		_cache_dir(volume, dir, pos + CACHE_ALIGN(volume->nsweeps*sizeof(CacheSweep)));
+		_cache_volume(&header.volume[type], volume, pos);
+		ok = ok && fseek(fd, pos, SEEK_SET) == 0 &&
+			_cache_put(fd, dir, volume->nsweeps*sizeof(CacheSweep)) &&
+			_cache_arrays(fd, volume) &&
+			fflush(fd) == 0 &&
+			fseek(fd, 0, SEEK_SET) == 0 &&
+			fwrite(&header, sizeof(header), 1, fd) == 1;
+		g_free(dir);
+	}
+	if (fclose(fd) != 0)
+		ok = FALSE;
+	if (!ok)
+		g_warning("AWeatherStore: cache_append - unable to write %s", store->cache);
+	g_mutex_unlock(&cache_lock);
+	return ok;
+}
+
+static AWeatherSweep *_cache_sweep(const CacheSweep *cs, gint type,
+		const gchar *data, gsize len)
+{
+	gsize nfloats = (gsize)cs->nrays*sizeof(gfloat);
+	gsize ncodes  = (gsize)cs->nrays*cs->nbins*cs->depth;
+	if (cs->nrays <= 0 || cs->nbins <= 0 || (cs->depth != 1 && cs->depth != 2) ||
+	    cs->azimuth > len || len - cs->azimuth < nfloats ||
+	    cs->elevs   > len || len - cs->elevs   < nfloats ||
+	    cs->codes   > len || len - cs->codes   < ncodes)
+		return NULL;
+	AWeatherSweep *sweep = g_new0(AWeatherSweep, 1);
+	sweep->type       = type;
+	sweep->elev       = cs->elev;
+	sweep->beam_width = cs->beam_width;
+	sweep->range_bin1 = cs->range_bin1;
+	sweep->gate_size  = cs->gate_size;
+	sweep->gain       = cs->gain;
+	sweep->offset     = cs->offset;
+	sweep->nrays      = cs->nrays;
+	sweep->nbins      = cs->nbins;
+	sweep->depth      = cs->depth;
+	sweep->azimuth    = (gfloat*)(data + cs->azimuth);
+	sweep->elevs      = (gfloat*)(data + cs->elevs);
+	sweep->codes      = (gpointer)(data + cs->codes);
+	sweep->mapped     = TRUE;
+	aweather_sweep_index(sweep);
+	return sweep;
+}
+
+
+/**************
+ * Quick look *
+ **************/
+/* A decimated copy of the lowest reflectivity cut, decoded straight from
+ * the start of a compressed file that is still being downloaded. Records
+ * are decompressed once as they arrive, the file position is kept between
+ * updates. */
+#define QUICK_RAYS 360    // One degree rays
+#define QUICK_GATE 1000.0 // Approximate gate size, m
+
+typedef AWeatherQuick Quick;
+
+struct _AWeatherQuick {
+	gchar         *file;
+	goffset        pos;    // Start of the next bzip2 record
+	AWeatherStore *store;
+	AWeatherSweep *sweep;
+	gint           cut;    // Elevation number being collected
+	gint           decim;  // Source gates for each output gate
+	gdouble        elev;   // Sum of the radial elevations
+	gint           count;
+	gboolean       done;
+};
+
+static void _quick_init(Quick *quick, const guint8 *radial,
+		const guint8 *vol, const guint8 *ref)
+{
+	gint   ngates = _be16(ref+8);
+	gint   first  = (gint16)_be16(ref+10);
+	gint   step   = (gint16)_be16(ref+12);
+	gfloat scale  = _bef32(ref+20);
+	gfloat offset = _bef32(ref+24);
+	quick->decim  = MAX(1, (gint)(QUICK_GATE/step + 0.5));
+
+	AWeatherSweep *sweep = aweather_sweep_new(DZ_INDEX, QUICK_RAYS,
+			(ngates + quick->decim-1) / quick->decim, 1);
+	sweep->beam_width = 360.0 / QUICK_RAYS;
+	sweep->gate_size  = step * quick->decim;
+	sweep->range_bin1 = first + step * (quick->decim-1) / 2.0;
+	sweep->gain       = 1 / scale;
+	sweep->offset     = -offset / scale;
+	for (gint ri = 0; ri < QUICK_RAYS; ri++)
+		sweep->azimuth[ri] = ri + 0.5;
+	quick->sweep = sweep;
+
+	/* Julian date, day 1 is 1970-01-01 */
+	AWeatherStore *store = g_new0(AWeatherStore, 1);
+	g_mutex_init(&store->lock);
+	memcpy(store->site, radial, 4);
+	store->time = (time_t)(_be16(radial+8)-1) * 24*60*60 + _be32(radial+4)/1000;
+	if (vol) {
+		store->center.lat  = _bef32(vol+8);
+		store->center.lon  = _bef32(vol+12);
+		store->center.elev = (gint16)_be16(vol+16);
+	}
+	quick->store = store;
+}
+
+/* Add one message 31 radial, size is the length of the radial */
+static void _quick_radial(Quick *quick, const guint8 *radial, gsize size)
+{
+	const guint8 *vol = NULL, *ref = NULL;
+	gint nblock = MIN(_be16(radial+30), 9);
+	for (gint bi = 0; bi < nblock; bi++) {
+		guint32 ptr = _be32(radial + 32 + bi*4);
+		if (ptr == 0 || ptr+28 > size)
+			continue;
+		if (!memcmp(radial+ptr, "RVOL", 4)) vol = radial+ptr;
+		if (!memcmp(radial+ptr, "DREF", 4)) ref = radial+ptr;
+	}
+	if (ref == NULL || ref[19] != 8 || _be16(ref+12) == 0 ||
+	    _bef32(ref+20) <= 0 || (ref-radial)+28+_be16(ref+8) > size)
+		return;
+
+	/* Use the first cut with reflectivity, stop when it ends */
+	gint cut    = radial[22];
+	gint status = radial[21];
+	if (quick->cut == 0)
+		quick->cut = cut;
+	if (cut != quick->cut) {
+		quick->done = quick->sweep != NULL;
+		return;
+	}
+	if (quick->sweep == NULL)
+		_quick_init(quick, radial, vol, ref);
+
+	/* Keep the strongest gate when decimating */
+	AWeatherSweep *sweep  = quick->sweep;
+	const guint8  *data   = ref + 28;
+	gint           ngates = MIN(_be16(ref+8), sweep->nbins * quick->decim);
+	gfloat         az     = _bef32(radial+12);
+	if (!(az >= 0 && az < 360))
+		return;
+	gint           ri     = (gint)az % QUICK_RAYS;
+	for (gint gi = 0; gi < ngates; gi++) {
+		gint bi = gi / quick->decim;
+		if (data[gi] > aweather_sweep_code(sweep, ri, bi))
+			aweather_sweep_set(sweep, ri, bi, data[gi]);
+	}
+	quick->elev += _bef32(radial+24);
+	quick->count++;
+	quick->done = status == 2 || status == 4; // End of elevation or volume
+}
+
+/* Walk the messages in a decompressed record */
+static void _quick_record(Quick *quick, const guint8 *data, gsize len)
+{
+	for (gsize pos = 0; pos + 12+16 <= len && !quick->done;) {
+		const guint8 *msg  = data + pos + 12;
+		gsize         size = _be16(msg) * 2;
+		if (msg[3] != 31) {
+			pos += 2432;
+			continue;
+		}
+		if (size < 16+68 || pos + 12+size > len)
+			break;
+		_quick_radial(quick, msg+16, size-16);
+		pos += 12 + size;
+	}
+}
+
+static void _quick_reset(Quick *quick)
+{
+	if (quick->sweep)
+		aweather_sweep_free(quick->sweep);
+	if (quick->store)
+		aweather_store_free(quick->store);
+	gchar *file = quick->file;
+	memset(quick, 0, sizeof(Quick));
+	quick->file = file;
+	quick->pos  = 24;
+}
+
+AWeatherQuick *aweather_quick_new(const gchar *file)
+{
+	Quick *quick = g_new0(Quick, 1);
+	quick->file = g_strdup(file);
+	quick->pos  = 24;
+	return quick;
+}
+
+/* Decompress the bzip2 records that have been fully downloaded since the
+ * last update. Once the lowest cut is complete the store is returned and
+ * belongs to the caller, NULL is returned until then. */
+AWeatherStore *aweather_quick_update(AWeatherQuick *quick)
+{
+	if (quick->done)
+		return NULL;
+	FILE *fd = g_fopen(quick->file, "rb");
+	if (fd == NULL)
+		return NULL;
+	struct stat st;
+	if (fstat(fileno(fd), &st) != 0 || st.st_size < quick->pos) {
+		/* The download was restarted */
+		_quick_reset(quick);
+		fclose(fd);
+		return NULL;
+	}
+
+	gchar *data = NULL, *buf = NULL;
+	guint  cap  = 1<<20;
+	while (!quick->done && quick->pos + 4 <= st.st_size) {
+		guint8 head[4];
+		if (fseeko(fd, quick->pos, SEEK_SET) != 0 ||
+		    fread(head, 4, 1, fd) != 1)
+			break;
+		gint32 size = ABS((gint32)_be32(head));
+		if (size <= 0 || quick->pos+4 + size > st.st_size)
+			break;
+		data = g_realloc(data, size);
+		if (fread(data, size, 1, fd) != 1)
+			break;
+		guint out;
+		gint  status;
+		do {
+			buf    = g_realloc(buf, cap);
+			out    = cap;
+			status = BZ2_bzBuffToBuffDecompress(buf, &out,
+					data, size, 0, 0);
+		} while (status == BZ_OUTBUFF_FULL && (cap *= 2) <= 64<<20);
+		if (status != BZ_OK) {
+			/* Not a volume that can be quick looked, give up on it */
+			_quick_reset(quick);
+			quick->done = TRUE;
+			break;
+		}
+		_quick_record(quick, (guint8*)buf, out);
+		quick->pos += 4 + size;
+	}
+	g_free(buf);
+	g_free(data);
+	fclose(fd);
+
+	if (!quick->done || !quick->store)
+		return NULL;
+	g_debug("AWeatherStore: quick_update - %d radials", quick->count);
+
+	AWeatherSweep *sweep = quick->sweep;
+	sweep->elev = quick->elev / quick->count;
+	for (gint ri = 0; ri < sweep->nrays; ri++)
+		sweep->elevs[ri] = sweep->elev;
+	aweather_sweep_index(sweep);
+
+	AWeatherVolume *volume = _volume_new(DZ_INDEX, NULL);
+	volume->sweep    = g_new0(AWeatherSweep*, 1);
+	volume->sweep[0] = sweep;
+	volume->nsweeps  = 1;
+	volume->tilts    = g_new0(gfloat, 1);
+	volume->tilts[0] = sweep->elev;
+	volume->ntilts   = 1;
+	volume->loaded   = TRUE;
+
+	AWeatherStore *store = quick->store;
+	store->volume[DZ_INDEX] = volume;
+	quick->store = NULL;
+	quick->sweep = NULL;
+	return store;
+}
+
+void aweather_quick_free(AWeatherQuick *quick)
+{
+	_quick_reset(quick);
+	g_free(quick->file);
+	g_free(quick);
+}
+
+
+/******************
+ * Real-time feed *
+ ******************/
+/* The real-time feed splits each volume into chunks, the start chunk has
+ * the volume header and every chunk holds whole bzip2 records. Records are
+ * decompressed as each chunk arrives and appended to a file laid out the
+ * same as one written by wsr88ddec, so the volume so far can be read like
+ * any other decompressed file. */
+AWeatherIngest *aweather_ingest_new(const gchar *raw)
+{
+	AWeatherIngest *ingest = g_new0(AWeatherIngest, 1);
+	ingest->raw = g_strdup(raw);
+	g_remove(raw);
+	return ingest;
+}
+
+/* Count the cuts ended by the messages in a decompressed record */
+static void _ingest_record(AWeatherIngest *ingest, const guint8 *data, gsize len)
+{
+	for (gsize pos = 0; pos + 12+16 <= len;) {
+		const guint8 *msg  = data + pos + 12;
+		gsize         size = _be16(msg) * 2;
+		if (msg[3] != 31) {
+			pos += 2432;
+			continue;
+		}
+		if (size < 16+68 || pos + 12+size > len)
+			break;
+		gint status = msg[16+21];
+		if (status == 2 || status == 4) // End of elevation or volume
+			ingest->tilts++;
+		if (status == 4)
+			ingest->done = TRUE;
+		pos += 12 + size;
+	}
+}
+
+/* Add a chunk, returns FALSE if it can't be used. Chunks must be added in
+ * order starting with the start chunk. */
+gboolean aweather_ingest_chunk(AWeatherIngest *ingest, const gchar *file)
+{
+	gchar *data;
+	gsize  len;
+	if (!g_file_get_contents(file, &data, &len, NULL))
+		return FALSE;
+
+	/* Volume header */
+	gsize pos = 0;
+	gboolean start = len >= 24 && !memcmp(data, "AR2V", 4);
+	if (start != (ingest->size == 0)) {
+		g_warning("AWeatherIngest: chunk - %s out of order", file);
+		g_free(data);
+		return FALSE;
+	}
+	FILE *fd = fopen(ingest->raw, "ab");
+	if (!fd) {
+		g_free(data);
+		return FALSE;
+	}
+	if (start) {
+		fwrite(data, 1, 24, fd);
+		ingest->size += 24;
+		pos = 24;
+	}
+
+	/* Records */
+	gchar *buf = NULL;
+	guint  cap = 1<<20;
+	gboolean ok = TRUE;
+	while (ok && pos + 4 <= len) {
+		gint32 size = ABS((gint32)_be32((guint8*)data+pos));
+		if (size <= 0 || pos+4 + size > len) {
+			ok = FALSE;
+			break;
+		}
+		guint out;
+		gint  status;
+		do {
+			buf    = g_realloc(buf, cap);
+			out    = cap;
+			status = BZ2_bzBuffToBuffDecompress(buf, &out,
+					data+pos+4, size, 0, 0);
+		} while (status == BZ_OUTBUFF_FULL && (cap *= 2) <= 64<<20);
+		ok = status == BZ_OK && fwrite(buf, 1, out, fd) == out;
+		if (ok) {
+			_ingest_record(ingest, (guint8*)buf, out);
+			ingest->size += out;
+		}
+		pos += 4 + size;
+	}
+	if (fclose(fd) != 0)
+		ok = FALSE;
+	if (!ok)
+		g_warning("AWeatherIngest: chunk - unable to decode %s", file);
+	g_debug("AWeatherIngest: chunk - %s, %d tilts%s", file,
+			ingest->tilts, ingest->done ? ", done" : "");
+	g_free(buf);
+	g_free(data);
+	return ok;
+}
+
+/* Load the volume so far. Moments are decoded later from a copy of it, so
+ * chunks can keep being added to the file in the meantime. */
+AWeatherStore *aweather_ingest_store(AWeatherIngest *ingest, const gchar *site)
+{
+	gchar *data;
+	gsize  len;
+	if (!g_file_get_contents(ingest->raw, &data, &len, NULL))
+		return NULL;
+	gchar   *copy = g_strconcat(ingest->raw, ".XXXXXX", NULL);
+	gint     fno  = g_mkstemp(copy);
+	FILE    *fd   = fno >= 0 ? fdopen(fno, "wb") : NULL;
+	gsize    size = MIN(len, ingest->size);
+	if (fno >= 0 && fd == NULL)
+		close(fno);
+	gboolean ok   = fd != NULL && fwrite(data, 1, size, fd) == size;
+	if (fd && fclose(fd) != 0)
+		ok = FALSE;
+	g_free(data);
+
+	AWeatherStore *store = ok ? aweather_store_new_from_file(copy, site) : NULL;
+	if (store)
+		store->snapshot = TRUE;
+	else if (fno >= 0)
+		g_remove(copy);
+	g_free(copy);
+	return store;
+}
+
+void aweather_ingest_free(AWeatherIngest *ingest)
+{
+	g_remove(ingest->raw);
+	g_free(ingest->raw);
+	g_free(ingest);
+}
+
+
+/**********
+ * Stores *
+ **********/
+/* Copy the parts of a radar that are used, the radar can be freed
+ * afterwards. The radar's sweeps should be sorted first. */
+AWeatherStore *aweather_store_new(Radar *radar)
+{
+	Radar_header  *h     = &radar->h;
+	AWeatherStore *store = g_new0(AWeatherStore, 1);
+	g_strlcpy(store->site, h->radar_name, sizeof(store->site));
+	g_mutex_init(&store->lock);
+
+	GDateTime *date = g_date_time_new_utc(h->year, h->month, h->day,
+			h->hour, h->minute, h->sec);
+	store->time = date ? g_date_time_to_unix(date) : 0;
+	if (date)
+		g_date_time_unref(date);
+
+	store->center.lat  = (double)h->latd + (double)h->latm/60 + (double)h->lats/(60*60);
+	store->center.lon  = (double)h->lond + (double)h->lonm/60 + (double)h->lons/(60*60);
+	store->center.elev = h->height;
+
+	for (gint vi = 0; vi < MIN(h->nvolumes, MAX_RADAR_VOLUMES); vi++) {
+		if (radar->v[vi] == NULL)
+			continue;
+		store->volume[vi] = _volume_new(vi, radar->v[vi]->h.type_str);
+		_volume_load_rsl(store->volume[vi], radar->v[vi]);
+	}
+	return store;
+}
+
+/* Load a decompressed file. Only reflectivity is decoded up front, the
+ * other moments are listed from the message headers and decoded the first
+ * time they're used. Older files are decoded all at once. */
+AWeatherStore *aweather_store_new_from_file(const gchar *file, const gchar *site)
+{
+	AWeatherVolume *found[MAX_RADAR_VOLUMES] = {};
+	gboolean lazy  = _scan(file, found);
+	Radar   *radar = _read(file, site, lazy ? "dz" : "all");
+	AWeatherStore *store = radar ? aweather_store_new(radar) : NULL;
+	if (radar)
+		RSL_free_radar(radar);
+
+	for (gint vi = 0; vi < MAX_RADAR_VOLUMES; vi++) {
+		if (found[vi] == NULL)
+			continue;
+		if (store && store->volume[vi] == NULL)
+			store->volume[vi] = found[vi];
+		else
+			_volume_free(found[vi]);
+	}
+	if (store)
+		store->file = g_strdup(file);
+	return store;
+}
+
+/* Load a store saved by aweather_store_save, the sweeps are mapped rather
+ * than read. Moments that were never decoded are loaded from the
+ * decompressed file later on. NULL is returned if the source has changed
+ * since the cache was written. */
+AWeatherStore *aweather_store_new_from_cache(const gchar *cache,
+		const gchar *source, const gchar *file)
+{
+	GMappedFile *map = g_mapped_file_new(cache, FALSE, NULL);
+	if (!map)
+		return NULL;
+	const gchar       *data   = g_mapped_file_get_contents(map);
+	gsize              len    = g_mapped_file_get_length(map);
+	const CacheHeader *header = (const CacheHeader*)data;
+	gint64             size, mtime;
+	if (len < sizeof(CacheHeader) ||
+	    memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) ||
+	    header->version != CACHE_VERSION ||
+	    !_cache_stat(source, &size, &mtime) ||
+	    header->size != size || header->mtime != mtime) {
+		g_debug("AWeatherStore: new_from_cache - stale %s", cache);
+		g_mapped_file_unref(map);
+		return NULL;
+	}
+	g_debug("AWeatherStore: new_from_cache - %s", cache);
+
+	AWeatherStore *store = g_new0(AWeatherStore, 1);
+	g_mutex_init(&store->lock);
+	g_strlcpy(store->site, header->site, sizeof(store->site));
+	store->time        = header->time;
+	store->center.lat  = header->center[0];
+	store->center.lon  = header->center[1];
+	store->center.elev = header->center[2];
+	store->file        = g_strdup(file);
+	store->cache       = g_strdup(cache);
+	store->source      = g_strdup(source);
+	store->map         = map;
+
+	for (gint vi = 0; vi < MAX_RADAR_VOLUMES; vi++) {
+		const CacheVolume *cv = &header->volume[vi];
+		if (!cv->present)
+			continue;
+		gchar name[sizeof(cv->name)];
+		g_strlcpy(name, cv->name, sizeof(name));
+		AWeatherVolume *volume = store->volume[vi] = _volume_new(vi, name);
+		volume->loaded = cv->loaded;
+		volume->ntilts = CLAMP(cv->ntilts, 0, CACHE_TILTS);
+		volume->tilts  = g_new0(gfloat, volume->ntilts);
+		memcpy(volume->tilts, cv->tilts, volume->ntilts*sizeof(gfloat));
+		if (cv->nsweeps < 0 || cv->dir % 8 || cv->dir > len ||
+		    (len - cv->dir) / sizeof(CacheSweep) < cv->nsweeps)
+			goto corrupt;
+		const CacheSweep *dir = (const CacheSweep*)(data + cv->dir);
+		volume->sweep = g_new0(AWeatherSweep*, cv->nsweeps);
+		for (gint si = 0; si < cv->nsweeps; si++) {
+			AWeatherSweep *sweep = _cache_sweep(&dir[si], vi, data, len);
+			if (sweep == NULL)
+				goto corrupt;
+			volume->sweep[volume->nsweeps++] = sweep;
+		}
+	}
+	return store;
+
+corrupt:
+	g_warning("AWeatherStore: new_from_cache - corrupt %s", cache);
+	aweather_store_free(store);
+	return NULL;
+}
+
+/* Write the store to a cache file, source is the file that the cache will
+ * be checked against. Moments loaded later are added to the end of it. */
+gboolean aweather_store_save(AWeatherStore *store, const gchar *cache, const gchar *source)
+{
+	g_mutex_lock(&store->lock);
+	g_free(store->cache);
+	g_free(store->source);
+	store->cache  = g_strdup(cache);
+	store->source = g_strdup(source);
+	gboolean ok = _cache_write(store);
+	g_mutex_unlock(&store->lock);
+	return ok;
+}
+
+void aweather_store_free(AWeatherStore *store)
+{
+	for (gint vi = 0; vi < MAX_RADAR_VOLUMES; vi++)
+		if (store->volume[vi])
+			_volume_free(store->volume[vi]);
+	if (store->map)
+		g_mapped_file_unref(store->map);
+	g_mutex_clear(&store->lock);
+	if (store->snapshot)
+		g_remove(store->file);
+	g_free(store->file);
+	g_free(store->cache);
+	g_free(store->source);
+	g_free(store);
+}
+
+/* Find the volume for a moment, decoding it the first time it's used */
+AWeatherVolume *aweather_store_volume(AWeatherStore *store, gint type)
+{
+	if (type < 0 || type >= MAX_RADAR_VOLUMES || !store->volume[type])
+		return NULL;
+	AWeatherVolume *volume = store->volume[type];
+	if (aweather_store_ready(store, type))
+		return volume;
+
+	/* Only the decode is locked, other moments can be used meanwhile */
+	g_mutex_lock(&store->lock);
+	if (!g_atomic_int_get(&volume->loaded)) {
+		gint   m     = _moment(type);
+		Radar *radar = _read(store->file, store->site, moments[m].field);
+		if (radar && radar->v[type])
+			_volume_load_rsl(volume, radar->v[type]);
+		else
+			g_warning("AWeatherStore: volume - unable to load %s", volume->name);
+		if (radar)
+			RSL_free_radar(radar);
+		g_atomic_int_set(&volume->loaded, TRUE);
+		if (store->cache)
+			_cache_append(store, type);
+	}
+	g_mutex_unlock(&store->lock);
+	return volume;
+}
+
+/* Check if a moment can be used without waiting for it to be decoded. This
+ * doesn't block, a moment being decoded on another thread isn't ready. */
+gboolean aweather_store_ready(AWeatherStore *store, gint type)
+{
+	if (type < 0 || type >= MAX_RADAR_VOLUMES || !store->volume[type])
+		return TRUE;
+	return g_atomic_int_get(&store->volume[type]->loaded) ||
+		!store->file || _moment(type) < 0;
+}
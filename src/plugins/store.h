@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2009-2012 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __AWEATHER_STORE_H__
+#define __AWEATHER_STORE_H__
+
+#include <glib.h>
+#include <grits.h>
+#include <rsl.h>
+#include "radar-info.h"
+
+/* Compact copy of a sweep. The gate codes for every ray are kept in one
+ * array, along with the linear mapping used to convert them to values. */
+typedef struct {
+	gint          type;       // Moment, e.g. DZ_INDEX
+	gfloat        elev;       // Elevation angle, degrees
+	gfloat        beam_width; // Degrees
+	gfloat        range_bin1; // Range to the center of the first gate, m
+	gfloat        gate_size;  // m
+	gfloat        gain;       // value = code*gain + offset,
+	gfloat        offset;     //   codes below CODE_MIN are flags
+	gint          nrays;
+	gint          nbins;      // Gates in each ray
+	gint          depth;      // Bytes for each code, 1 or 2
+	gfloat       *azimuth;    // Azimuth of each ray, degrees
+	gfloat       *elevs;      // Elevation of each ray, degrees
+	gpointer      codes;      // nrays*nbins gate codes
+	RadarAzIndex *index;      // Ray covering each azimuth
+	gboolean      mapped;     // Arrays point into a cache file
+} AWeatherSweep;
+
+/* The elevation of each tilt is known when the file is opened, the
+ * sweeps themselves are only decoded when the moment is first used. */
+typedef struct {
+	gint            type;
+	gchar          *name;     // E.g. "Reflectivity"
+	gint            ntilts;
+	gfloat         *tilts;    // Elevation of each sweep, sorted
+	gint            loaded;   // Sweeps have been decoded, read atomically
+	gint            nsweeps;
+	AWeatherSweep **sweep;    // Sorted by elevation
+} AWeatherVolume;
+
+typedef struct {
+	gchar           site[8];
+	time_t          time;
+	GritsPoint      center;
+	gchar          *file;     // Decompressed file, for loading moments later
+	gboolean        snapshot; // The file is removed when the store is freed
+	gchar          *cache;    // Cache file, moments are added as they're loaded
+	gchar          *source;   // File the cache is checked against
+	GMappedFile    *map;      // Cache file the sweeps were read from
+	GMutex          lock;
+	AWeatherVolume *volume[MAX_RADAR_VOLUMES];
+} AWeatherStore;
+
+/* Quick look of a compressed file that is still being downloaded */
+typedef struct _AWeatherQuick AWeatherQuick;
+
+/* Volume from the real-time feed, decompressed as chunks arrive */
+typedef struct {
+	gchar          *raw;      // Decompressed volume so far, removed when freed
+	gsize           size;     // Bytes written to raw
+	gint            tilts;    // Elevation cuts completed
+	gboolean        done;     // The end of the volume was seen
+} AWeatherIngest;
+
+/* Sweeps */
+AWeatherSweep *aweather_sweep_new(gint type, gint nrays, gint nbins, gint depth);
+
+void aweather_sweep_index(AWeatherSweep *sweep);
+
+void aweather_sweep_free(AWeatherSweep *sweep);
+
+static inline guint aweather_sweep_code(AWeatherSweep *sweep, gint ri, gint bi)
+{
+	gsize i = (gsize)ri*sweep->nbins + bi;
+	return sweep->depth == 1 ? ((guint8 *)sweep->codes)[i]
+	                         : ((guint16*)sweep->codes)[i];
+}
+
+static inline void aweather_sweep_set(AWeatherSweep *sweep, gint ri, gint bi, guint code)
+{
+	gsize i = (gsize)ri*sweep->nbins + bi;
+	if (sweep->depth == 1)
+		((guint8 *)sweep->codes)[i] = MIN(code, G_MAXUINT8);
+	else
+		((guint16*)sweep->codes)[i] = MIN(code, G_MAXUINT16);
+}
+
+static inline gfloat aweather_sweep_value(AWeatherSweep *sweep, guint code)
+{
+	return code * sweep->gain + sweep->offset;
+}
+
+/* Volumes */
+AWeatherSweep *aweather_volume_closest(AWeatherVolume *volume, gfloat elev);
+
+/* Stores */
+AWeatherStore *aweather_store_new(Radar *radar);
+
+AWeatherStore *aweather_store_new_from_file(const gchar *file, const gchar *site);
+
+AWeatherStore *aweather_store_new_from_cache(const gchar *cache,
+		const gchar *source, const gchar *file);
+
+AWeatherQuick *aweather_quick_new(const gchar *file);
+
+AWeatherStore *aweather_quick_update(AWeatherQuick *quick);
+
+void aweather_quick_free(AWeatherQuick *quick);
+
+AWeatherIngest *aweather_ingest_new(const gchar *raw);
+
+gboolean aweather_ingest_chunk(AWeatherIngest *ingest, const gchar *file);
+
+AWeatherStore *aweather_ingest_store(AWeatherIngest *ingest, const gchar *site);
+
+void aweather_ingest_free(AWeatherIngest *ingest);
+
+gboolean aweather_store_save(AWeatherStore *store, const gchar *cache, const gchar *source);
+
+void aweather_store_free(AWeatherStore *store);
+
+AWeatherVolume *aweather_store_volume(AWeatherStore *store, gint type);
+
+gboolean aweather_store_ready(AWeatherStore *store, gint type);
+
+#endif
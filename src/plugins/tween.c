@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2009-2012 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <math.h>
+#include <string.h>
+#include <grits.h>
+
+#include "tween.h"
+
+#define TWEEN_ECHO 20 // Weakest reflectivity used for tracking, dBZ
+
+/* Work for one thread */
+typedef struct {
+	AWeatherSweep      *a, *b, *out;
+	AWeatherTweenField *field;
+	AWeatherColormap   *colormap;
+	gfloat              t;
+	guint8             *pixels;
+	gint                ri0, ri1;
+} TweenJob;
+
+AWeatherTweenMode aweather_tween_mode(const gchar *name)
+{
+	if (g_strcmp0(name, "fade")   == 0) return TWEEN_FADE;
+	if (g_strcmp0(name, "motion") == 0) return TWEEN_MOTION;
+	return TWEEN_NONE;
+}
+
+/* Find the gate at a point east and north of the radar, in meters */
+static guint _tween_code(AWeatherSweep *sweep, gdouble east, gdouble north)
+{
+	gint ri = radar_azindex_get(sweep->index, atan2(east, north)*180/G_PI);
+	gint bi = floor((hypot(east, north) - sweep->range_bin1) / sweep->gate_size + 0.5);
+	if (ri < 0 || bi < 0 || bi >= sweep->nbins)
+		return 0;
+	return aweather_sweep_code(sweep, ri, bi);
+}
+
+
+/****************
+ * Motion field *
+ ****************/
+/* Reflectivity on a grid centered on the radar, in whole dBZ */
+static guint8 *_tween_grid(AWeatherSweep *sweep)
+{
+	guint8 *grid = g_malloc0(TWEEN_SIZE*TWEEN_SIZE);
+	for (gint y = 0; y < TWEEN_SIZE; y++)
+	for (gint x = 0; x < TWEEN_SIZE; x++) {
+		gdouble east  = (x + 0.5 - TWEEN_SIZE/2) * TWEEN_PIXEL;
+		gdouble north = (y + 0.5 - TWEEN_SIZE/2) * TWEEN_PIXEL;
+		guint   code  = _tween_code(sweep, east, north);
+		if (code >= CODE_MIN)
+			grid[y*TWEEN_SIZE+x] = CLAMP(aweather_sweep_value(sweep, code), 0, 255);
+	}
+	return grid;
+}
+
+/* Sum of absolute differences between a block and the same block moved */
+static guint _tween_sad(guint8 *a, guint8 *b, gint x0, gint y0, gint dx, gint dy)
+{
+	guint sad = 0;
+	for (gint y = y0; y < y0+TWEEN_BLOCK; y++)
+	for (gint x = x0; x < x0+TWEEN_BLOCK; x++) {
+		gint bx = x+dx, by = y+dy;
+		gint bv = bx < 0 || bx >= TWEEN_SIZE || by < 0 || by >= TWEEN_SIZE ?
+			0 : b[by*TWEEN_SIZE+bx];
+		sad += ABS(a[y*TWEEN_SIZE+x] - bv);
+	}
+	return sad;
+}
+
+/* Estimate how echoes moved from a to b by matching blocks of the first
+ * sweep against the second. Blocks without enough echo to track take the
+ * average motion, and the field is smoothed so frames don't tear. */
+AWeatherTweenField *aweather_tween_field(AWeatherSweep *a, AWeatherSweep *b)
+{
+	g_debug("AWeatherTween: field - %p %p", a, b);
+	guint8 *ga = _tween_grid(a);
+	guint8 *gb = _tween_grid(b);
+	AWeatherTweenField *field = g_new0(AWeatherTweenField, 1);
+	gboolean found[TWEEN_BLOCKS][TWEEN_BLOCKS] = {};
+	gdouble  sum_u = 0, sum_v = 0;
+	gint     nfound = 0;
+
+	for (gint by = 0; by < TWEEN_BLOCKS; by++)
+	for (gint bx = 0; bx < TWEEN_BLOCKS; bx++) {
+		gint x0 = bx*TWEEN_BLOCK, y0 = by*TWEEN_BLOCK, echo = 0;
+		for (gint y = y0; y < y0+TWEEN_BLOCK; y++)
+		for (gint x = x0; x < x0+TWEEN_BLOCK; x++)
+			echo += ga[y*TWEEN_SIZE+x] >= TWEEN_ECHO;
+		if (echo < TWEEN_BLOCK*TWEEN_BLOCK/10)
+			continue;
+
+		/* Prefer the smallest displacement on ties */
+		guint best = G_MAXUINT;
+		gint  du = 0, dv = 0;
+		for (gint dy = -TWEEN_SEARCH; dy <= TWEEN_SEARCH; dy++)
+		for (gint dx = -TWEEN_SEARCH; dx <= TWEEN_SEARCH; dx++) {
+			guint sad = _tween_sad(ga, gb, x0, y0, dx, dy);
+			if (sad < best || (sad == best && dx*dx+dy*dy < du*du+dv*dv)) {
+				best = sad;
+				du   = dx;
+				dv   = dy;
+			}
+		}
+		field->u[by][bx] = du * TWEEN_PIXEL;
+		field->v[by][bx] = dv * TWEEN_PIXEL;
+		found[by][bx]    = TRUE;
+		sum_u += field->u[by][bx];
+		sum_v += field->v[by][bx];
+		nfound++;
+	}
+	g_free(ga);
+	g_free(gb);
+
+	/* Fill in and smooth */
+	for (gint by = 0; by < TWEEN_BLOCKS; by++)
+	for (gint bx = 0; bx < TWEEN_BLOCKS; bx++) {
+		if (found[by][bx])
+			continue;
+		field->u[by][bx] = nfound ? sum_u / nfound : 0;
+		field->v[by][bx] = nfound ? sum_v / nfound : 0;
+	}
+	AWeatherTweenField copy = *field;
+	for (gint by = 0; by < TWEEN_BLOCKS; by++)
+	for (gint bx = 0; bx < TWEEN_BLOCKS; bx++) {
+		gdouble u = 0, v = 0;
+		gint    n = 0;
+		for (gint y = MAX(by-1, 0); y <= MIN(by+1, TWEEN_BLOCKS-1); y++)
+		for (gint x = MAX(bx-1, 0); x <= MIN(bx+1, TWEEN_BLOCKS-1); x++) {
+			u += copy.u[y][x];
+			v += copy.v[y][x];
+			n++;
+		}
+		field->u[by][bx] = u / n;
+		field->v[by][bx] = v / n;
+	}
+	return field;
+}
+
+/* Motion at a point, interpolated between block centers */
+static void _tween_motion(AWeatherTweenField *field, gdouble east, gdouble north,
+		gdouble *u, gdouble *v)
+{
+	gdouble fx = (east /TWEEN_PIXEL + TWEEN_SIZE/2) / TWEEN_BLOCK - 0.5;
+	gdouble fy = (north/TWEEN_PIXEL + TWEEN_SIZE/2) / TWEEN_BLOCK - 0.5;
+	fx = CLAMP(fx, 0, TWEEN_BLOCKS-1);
+	fy = CLAMP(fy, 0, TWEEN_BLOCKS-1);
+	gint    x0 = MIN((gint)fx, TWEEN_BLOCKS-2);
+	gint    y0 = MIN((gint)fy, TWEEN_BLOCKS-2);
+	gdouble wx = fx - x0, wy = fy - y0;
+	*u = (field->u[y0  ][x0]*(1-wx) + field->u[y0  ][x0+1]*wx) * (1-wy) +
+	     (field->u[y0+1][x0]*(1-wx) + field->u[y0+1][x0+1]*wx) * wy;
+	*v = (field->v[y0  ][x0]*(1-wx) + field->v[y0  ][x0+1]*wx) * (1-wy) +
+	     (field->v[y0+1][x0]*(1-wx) + field->v[y0+1][x0+1]*wx) * wy;
+}
+
+
+/**********
+ * Frames *
+ **********/
+/* Frames use the rays of the first sweep and every other gate, which
+ * keeps them at a quarter of the size of a full frame */
+AWeatherSweep *aweather_tween_sweep(AWeatherSweep *a)
+{
+	AWeatherSweep *out = g_new0(AWeatherSweep, 1);
+	*out = *a;
+	out->nbins      = (a->nbins+1) / 2;
+	out->gate_size  = a->gate_size * 2;
+	out->range_bin1 = a->range_bin1 + a->gate_size / 2;
+	out->azimuth    = g_new(gfloat, a->nrays);
+	out->elevs      = g_new(gfloat, a->nrays);
+	memcpy(out->azimuth, a->azimuth, a->nrays*sizeof(gfloat));
+	memcpy(out->elevs,   a->elevs,   a->nrays*sizeof(gfloat));
+	out->codes      = NULL;
+	out->index      = NULL;
+	out->mapped     = FALSE;
+	return out;
+}
+
+/* Same colors as the b-scan in level2.c */
+static void _tween_color(AWeatherSweep *sweep, AWeatherColormap *colormap,
+		guint code, gfloat rgba[4])
+{
+	if (code < CODE_MIN) {
+		rgba[0] = rgba[1] = rgba[2] = rgba[3] = 0;
+		return;
+	}
+	gint    idx  = aweather_sweep_value(sweep, code) * colormap->scale + colormap->shift;
+	guint8 *data = colormap->data[CLAMP(idx, 0, colormap->len-1)];
+	rgba[0] = data[0];
+	rgba[1] = data[1];
+	rgba[2] = data[2];
+	rgba[3] = data[3]*0.75;
+}
+
+static gpointer _tween_apply(gpointer _job)
+{
+	TweenJob      *job = _job;
+	AWeatherSweep *out = job->out;
+	gfloat         t   = job->t;
+	for (gint ri = job->ri0; ri < job->ri1; ri++) {
+		gdouble s = sin(deg2rad(out->azimuth[ri]));
+		gdouble c = cos(deg2rad(out->azimuth[ri]));
+		for (gint bi = 0; bi < out->nbins; bi++) {
+			gdouble range = out->range_bin1 + bi*out->gate_size;
+			gdouble east  = s*range, north = c*range;
+			gdouble u = 0, v = 0;
+			if (job->field)
+				_tween_motion(job->field, east, north, &u, &v);
+
+			/* Echoes at this point were at p-t*m in a and will be
+			 * at p+(1-t)*m in b */
+			gfloat ca[4], cb[4];
+			_tween_color(job->a, job->colormap,
+				_tween_code(job->a, east - t*u, north - t*v), ca);
+			_tween_color(job->b, job->colormap,
+				_tween_code(job->b, east + (1-t)*u, north + (1-t)*v), cb);
+			guint8 *pixel = &job->pixels[(ri*out->nbins + bi)*4];
+			for (gint i = 0; i < 4; i++)
+				pixel[i] = ca[i]*(1-t) + cb[i]*t;
+		}
+	}
+	return NULL;
+}
+
+/* Draw the frame at time t, from 0 (a) to 1 (b), into pixels. Out should
+ * come from aweather_tween_sweep(a) and pixels is out->nrays by
+ * out->nbins. The field is NULL for a cross fade. */
+void aweather_tween_frame(AWeatherSweep *a, AWeatherSweep *b,
+		AWeatherTweenField *field, AWeatherColormap *colormap,
+		gfloat t, AWeatherSweep *out, guint8 *pixels)
+{
+	/* Split the rays between threads */
+	gint      nthreads = CLAMP(g_get_num_processors(), 1, 8);
+	GThread  *threads[8];
+	TweenJob  jobs[8];
+	for (gint i = 0; i < nthreads; i++) {
+		jobs[i] = (TweenJob){a, b, out, field, colormap, t, pixels,
+			out->nrays*i/nthreads, out->nrays*(i+1)/nthreads};
+		threads[i] = i == 0 ? NULL :
+			g_thread_new("tween-thread", _tween_apply, &jobs[i]);
+	}
+	_tween_apply(&jobs[0]);
+	for (gint i = 1; i < nthreads; i++)
+		g_thread_join(threads[i]);
+}
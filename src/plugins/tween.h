@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2009-2012 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __AWEATHER_TWEEN_H__
+#define __AWEATHER_TWEEN_H__
+
+#include <glib.h>
+#include "store.h"
+
+/* Motion field grid, centered on the radar */
+#define TWEEN_PIXEL   1000.0 // Meters per pixel
+#define TWEEN_SIZE    512    // Pixels across the grid
+#define TWEEN_BLOCK   32     // Pixels across each block
+#define TWEEN_SEARCH  8      // Largest displacement searched, pixels
+#define TWEEN_BLOCKS  (TWEEN_SIZE/TWEEN_BLOCK)
+
+typedef enum {
+	TWEEN_NONE,
+	TWEEN_FADE,   // Cross fade between frames
+	TWEEN_MOTION, // Move echoes along a block matched motion field
+} AWeatherTweenMode;
+
+/* Displacement from the first sweep to the second, meters */
+typedef struct {
+	gfloat u[TWEEN_BLOCKS][TWEEN_BLOCKS]; // East
+	gfloat v[TWEEN_BLOCKS][TWEEN_BLOCKS]; // North
+} AWeatherTweenField;
+
+AWeatherTweenMode aweather_tween_mode(const gchar *name);
+
+AWeatherTweenField *aweather_tween_field(AWeatherSweep *a, AWeatherSweep *b);
+
+AWeatherSweep *aweather_tween_sweep(AWeatherSweep *a);
+
+void aweather_tween_frame(AWeatherSweep *a, AWeatherSweep *b,
+		AWeatherTweenField *field, AWeatherColormap *colormap,
+		gfloat t, AWeatherSweep *out, guint8 *pixels);
+
+#endif
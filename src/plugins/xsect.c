@@ -0,0 +1,289 @@
+/*
+ * Copyright (C) 2009-2012 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <math.h>
+#include <string.h>
+#include <grits.h>
+#include <rsl.h>
+
+#include "xsect.h"
+
+#define XSECT_MAXTILTS 32
+
+/* Tilts of the volume being sampled, each has an azimuth index so
+ * columns can be sampled without searching */
+typedef struct {
+	AWeatherStore *store;
+	gint           type;
+	gint           ntilts;
+	AWeatherSweep *tilts[XSECT_MAXTILTS];
+} XsectTilts;
+
+struct _AWeatherXsect {
+	GritsObject      *owner;
+
+	/* Worker thread */
+	GThread          *thread;
+	GMutex            lock;
+	GCond             cond;
+	gboolean          running;
+	XsectTilts        tilts;      // Only used by the worker
+
+	/* Latest request, older requests are dropped */
+	gboolean          pending;
+	AWeatherStore    *store;
+	gint              type;
+	AWeatherColormap *colormap;
+	gdouble           line[4];
+
+	/* Finished image, waiting to be uploaded */
+	gboolean          ready;
+	guint8            image[XSECT_ROWS][XSECT_COLS][4];
+	gdouble           image_line[4];
+	guint             idle;
+
+	/* OpenGL state, only used from the main thread */
+	guint             tex;
+	gboolean          shown;
+	gdouble           tex_line[4];
+};
+
+/* Collect the tilts of a volume, this is only redone when the
+ * store or the moment changes, not while the line is dragged */
+static void _xsect_tilts(XsectTilts *tilts, AWeatherStore *store, gint type)
+{
+	if (tilts->store == store && tilts->type == type)
+		return;
+	g_debug("AWeatherXsect: tilts - %p %d", store, type);
+	tilts->store  = store;
+	tilts->type   = type;
+	tilts->ntilts = 0;
+	AWeatherVolume *volume = aweather_store_volume(store, type);
+	if (!volume)
+		return;
+	gfloat elev = 0;
+	for (gint si = 0; si < volume->nsweeps; si++) {
+		AWeatherSweep *sweep = volume->sweep[si];
+		if (sweep->elev == 0 || sweep->elev == elev ||
+		    tilts->ntilts >= XSECT_MAXTILTS)
+			continue;
+		elev = sweep->elev;
+		tilts->tilts[tilts->ntilts++] = sweep;
+	}
+}
+
+/* Sample the volume along the line, one column at a time. For each
+ * column the beam heights are computed once, then rows are walked from
+ * the ground up picking the closest tilt whose beam covers the row. */
+static void _xsect_sample(XsectTilts *tilts, AWeatherColormap *colormap,
+		gdouble line[4], guint8 image[XSECT_ROWS][XSECT_COLS][4])
+{
+	memset(image, 0, XSECT_ROWS*XSECT_COLS*4);
+	gint ntilts = tilts->ntilts;
+	for (gint c = 0; c < XSECT_COLS; c++) {
+		gdouble f      = (c + 0.5) / XSECT_COLS;
+		gdouble east   = line[0] + (line[2]-line[0])*f;
+		gdouble north  = line[1] + (line[3]-line[1])*f;
+		gdouble dist   = hypot(east, north);
+		gdouble az     = atan2(east, north)*180/G_PI;
+		gdouble spread = dist * tan(deg2rad(0.5));
+
+		/* Beam height, ray and gate for each tilt at this distance */
+		gdouble height[XSECT_MAXTILTS];
+		gint    ray[XSECT_MAXTILTS];
+		gint    gate[XSECT_MAXTILTS];
+		for (gint k = 0; k < ntilts; k++) {
+			AWeatherSweep *tilt = tilts->tilts[k];
+			gdouble range;
+			beam_height(dist, tilt->elev, &height[k], &range);
+			ray[k]  = radar_azindex_get(tilt->index, az);
+			gate[k] = floor((range - tilt->range_bin1) / tilt->gate_size + 0.5);
+		}
+
+		for (gint r = 0, k = 0; r < XSECT_ROWS && ntilts > 0; r++) {
+			gdouble h = (r + 0.5) * XSECT_TOP / XSECT_ROWS;
+			while (k+1 < ntilts && fabs(height[k+1]-h) < fabs(height[k]-h))
+				k++;
+			AWeatherSweep *tilt = tilts->tilts[k];
+			if (fabs(height[k]-h) > spread || ray[k] < 0 ||
+			    gate[k] < 0 || gate[k] >= tilt->nbins)
+				continue;
+			guint code = aweather_sweep_code(tilt, ray[k], gate[k]);
+			if (code < CODE_MIN)
+				continue;
+			float value = aweather_sweep_value(tilt, code);
+			gint  idx   = value * colormap->scale + colormap->shift;
+			memcpy(image[r][c], colormap->data[CLAMP(idx, 0, colormap->len-1)], 4);
+		}
+	}
+}
+
+static gboolean _xsect_idle(gpointer _xsect)
+{
+	AWeatherXsect *xsect = _xsect;
+	g_mutex_lock(&xsect->lock);
+	xsect->idle = 0;
+	g_mutex_unlock(&xsect->lock);
+	grits_object_queue_draw(xsect->owner);
+	return FALSE;
+}
+
+static gpointer _xsect_thread(gpointer _xsect)
+{
+	AWeatherXsect *xsect = _xsect;
+	guint8 (*image)[XSECT_COLS][4] = g_malloc(sizeof(xsect->image));
+	g_mutex_lock(&xsect->lock);
+	while (TRUE) {
+		while (xsect->running && !xsect->pending)
+			g_cond_wait(&xsect->cond, &xsect->lock);
+		if (!xsect->running)
+			break;
+
+		/* Take the latest request */
+		AWeatherStore    *store    = xsect->store;
+		gint              type     = xsect->type;
+		AWeatherColormap *colormap = xsect->colormap;
+		gdouble           line[4];
+		memcpy(line, xsect->line, sizeof(line));
+		xsect->pending = FALSE;
+		g_mutex_unlock(&xsect->lock);
+
+		_xsect_tilts(&xsect->tilts, store, type);
+		_xsect_sample(&xsect->tilts, colormap, line, image);
+
+		/* Hand the image to the main thread */
+		g_mutex_lock(&xsect->lock);
+		memcpy(xsect->image, image, sizeof(xsect->image));
+		memcpy(xsect->image_line, line, sizeof(line));
+		xsect->ready = TRUE;
+		if (!xsect->idle)
+			xsect->idle = g_idle_add(_xsect_idle, xsect);
+	}
+	g_mutex_unlock(&xsect->lock);
+	g_free(image);
+	return NULL;
+}
+
+/* Queue a new cross section, line is the east and north offsets of the
+ * start and end points from the radar, in meters */
+void aweather_xsect_request(AWeatherXsect *xsect, AWeatherStore *store, gint type,
+		AWeatherColormap *colormap, gdouble line[4])
+{
+	g_mutex_lock(&xsect->lock);
+	xsect->pending  = TRUE;
+	xsect->store    = store;
+	xsect->type     = type;
+	xsect->colormap = colormap;
+	memcpy(xsect->line, line, sizeof(xsect->line));
+	g_cond_signal(&xsect->cond);
+	g_mutex_unlock(&xsect->lock);
+}
+
+/* Stop showing the current cross section */
+void aweather_xsect_clear(AWeatherXsect *xsect)
+{
+	g_mutex_lock(&xsect->lock);
+	xsect->pending = FALSE;
+	xsect->ready   = FALSE;
+	g_mutex_unlock(&xsect->lock);
+	xsect->shown = FALSE;
+}
+
+/* Draw the line on the ground and the cross section above it, this is
+ * called from the owners draw function in the radar's local coordinates */
+void aweather_xsect_draw(AWeatherXsect *xsect)
+{
+	/* Upload new images */
+	g_mutex_lock(&xsect->lock);
+	if (xsect->ready) {
+		if (!xsect->tex) {
+			glGenTextures(1, &xsect->tex);
+			glBindTexture(GL_TEXTURE_2D, xsect->tex);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, XSECT_COLS, XSECT_ROWS, 0,
+					GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+		glBindTexture(GL_TEXTURE_2D, xsect->tex);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0,0, XSECT_COLS,XSECT_ROWS,
+				GL_RGBA, GL_UNSIGNED_BYTE, xsect->image);
+		memcpy(xsect->tex_line, xsect->image_line, sizeof(xsect->tex_line));
+		xsect->ready = FALSE;
+		xsect->shown = TRUE;
+	}
+	gdouble *line = xsect->line;
+	g_mutex_unlock(&xsect->lock);
+
+	/* Line on the ground */
+	glDisable(GL_TEXTURE_2D);
+	glDisable(GL_CULL_FACE);
+	glDisable(GL_LIGHTING);
+	glLineWidth(2);
+	glColor4f(1,1,1,1);
+	glBegin(GL_LINES);
+	glVertex3f(line[0], line[1], 10);
+	glVertex3f(line[2], line[3], 10);
+	glEnd();
+
+	if (!xsect->shown)
+		return;
+
+	/* Curtain, semi transparent so the sweep below still shows */
+	gdouble *tl = xsect->tex_line;
+	glEnable(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, xsect->tex);
+	glColor4f(1,1,1,0.9);
+	glBegin(GL_QUADS);
+	glTexCoord2f(0, 0); glVertex3f(tl[0], tl[1], 0);
+	glTexCoord2f(1, 0); glVertex3f(tl[2], tl[3], 0);
+	glTexCoord2f(1, 1); glVertex3f(tl[2], tl[3], XSECT_TOP);
+	glTexCoord2f(0, 1); glVertex3f(tl[0], tl[1], XSECT_TOP);
+	glEnd();
+}
+
+AWeatherXsect *aweather_xsect_new(GritsObject *owner)
+{
+	g_debug("AWeatherXsect: new - %p", owner);
+	AWeatherXsect *xsect = g_new0(AWeatherXsect, 1);
+	xsect->owner   = owner;
+	xsect->running = TRUE;
+	g_mutex_init(&xsect->lock);
+	g_cond_init(&xsect->cond);
+	xsect->thread = g_thread_new("xsect-thread", _xsect_thread, xsect);
+	return xsect;
+}
+
+void aweather_xsect_free(AWeatherXsect *xsect)
+{
+	g_debug("AWeatherXsect: free - %p", xsect);
+	g_mutex_lock(&xsect->lock);
+	xsect->running = FALSE;
+	g_cond_signal(&xsect->cond);
+	g_mutex_unlock(&xsect->lock);
+	g_thread_join(xsect->thread);
+	if (xsect->idle)
+		g_source_remove(xsect->idle);
+	if (xsect->tex)
+		glDeleteTextures(1, &xsect->tex);
+	g_mutex_clear(&xsect->lock);
+	g_cond_clear(&xsect->cond);
+	g_free(xsect);
+}
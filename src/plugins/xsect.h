@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2009-2012 Andy Spencer <andy753421@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __AWEATHER_XSECT_H__
+#define __AWEATHER_XSECT_H__
+
+#include <grits.h>
+#include "store.h"
+
+/* Size of the cross section image */
+#define XSECT_COLS 256      // Samples along the line
+#define XSECT_ROWS 128      // Samples in height
+#define XSECT_TOP  12800.0  // Height of the top row, meters
+
+typedef struct _AWeatherXsect AWeatherXsect;
+
+AWeatherXsect *aweather_xsect_new(GritsObject *owner);
+
+void aweather_xsect_free(AWeatherXsect *xsect);
+
+void aweather_xsect_request(AWeatherXsect *xsect, AWeatherStore *store, gint type,
+		AWeatherColormap *colormap, gdouble line[4]);
+
+void aweather_xsect_clear(AWeatherXsect *xsect);
+
+void aweather_xsect_draw(AWeatherXsect *xsect);
+
+#endif